@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT += core gui
+QT += core gui concurrent
 CONFIG += c++14
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
@@ -28,45 +28,30 @@ DEFINES += QT_DEPRECATED_WARNINGS
 # You can also select to disable deprecated APIs only up to a certain version of Qt.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+include(render_core.pri)
 
 SOURCES += main.cpp\
-    cube/cube_data.cpp \
-    cube/cube_util.cpp \
     cutoff_dialog.cpp \
-    frame_loader.cpp \
-    frame_util.cpp \
+    frame_cache.cpp \
     main_window.cpp \
     my_opengl_widget.cpp \
-    objects/cube.cpp \
     objects/hemisphere.cpp \
     objects/plane.cpp \
-    objects/triangulated_shape.cpp \
-    palette_util.cpp \
+    prepared_frame.cpp \
     raw_dialog.cpp \
-    render/ray_cast_renderer.cpp \
-    render/renderer.cpp \
+    render/cpu_ray_cast_renderer.cpp \
     render/slice_renderer.cpp
 
 HEADERS  += \
-    ../common/types.h \
-    cube/cube_data.h \
-    cube/cube_util.h \
     cutoff_dialog.h \
-    frame_loader.h \
-    frame_util.h \
+    frame_cache.h \
     main_window.h \
     my_opengl_widget.h \
-    objects/buffer.h \
-    objects/cube.h \
     objects/hemisphere.h \
     objects/plane.h \
-    objects/shape.h \
-    objects/triangulated_shape.h \
-    palette_util.h \
-    frame3d.h \
+    prepared_frame.h \
     raw_dialog.h \
-    render/ray_cast_renderer.h \
-    render/renderer.h \
+    render/cpu_ray_cast_renderer.h \
     render/slice_renderer.h
 
 FORMS    += \
@@ -77,6 +62,9 @@ FORMS    += \
 DISTFILES += \
     shaders/basic.vert \
     shaders/basic.frag \
+    shaders/feedback.frag \
+    shaders/image.frag \
+    shaders/image.vert \
     shaders/raycast.frag \
     shaders/raycast.vert \
     shaders/slice.frag \
@@ -0,0 +1,70 @@
+#include "brick_residency.h"
+
+BrickResidency::BrickResidency(size_t num_of_slots) {
+    reset(num_of_slots);
+}
+
+void BrickResidency::reset(size_t slots) {
+    num_of_slots = slots;
+    lru.clear();
+    entries.clear();
+    free_slots.clear();
+    // Slots are taken from the back, so lower slots are used first.
+    for (size_t i = num_of_slots; i > 0; i--) {
+        free_slots.push_back(i - 1);
+    }
+}
+
+void BrickResidency::touch(size_t brick) {
+    auto it = entries.find(brick);
+    if (it == entries.end()) {
+        return;
+    }
+    lru.splice(lru.begin(), lru, it->second.lru_pos);
+    it->second.last_frame = frame;
+}
+
+std::vector<BrickResidency::Load> BrickResidency::request(const std::vector<size_t> &used, const std::vector<size_t> &missing,
+                                                          size_t max_loads) {
+    frame++;
+    for (auto brick: used) {
+        touch(brick);
+    }
+    for (auto brick: missing) {
+        touch(brick);
+    }
+
+    std::vector<Load> loads;
+    for (auto brick: missing) {
+        if (loads.size() >= max_loads) {
+            break;
+        }
+        if (entries.count(brick)) {
+            continue;
+        }
+        Load load {brick, 0, false, 0};
+        if (!free_slots.empty()) {
+            load.slot = free_slots.back();
+            free_slots.pop_back();
+        } else {
+            // Bricks used in this frame are not evicted: the working set doesn't fit, so the rest waits.
+            if (lru.empty() || entries[lru.back()].last_frame == frame) {
+                break;
+            }
+            load.evicted = true;
+            load.evicted_brick = lru.back();
+            load.slot = entries[load.evicted_brick].slot;
+            entries.erase(load.evicted_brick);
+            lru.pop_back();
+        }
+        lru.push_front(brick);
+        entries[brick] = Entry {load.slot, frame, lru.begin()};
+        loads.push_back(load);
+    }
+    return loads;
+}
+
+int BrickResidency::slot(size_t brick) const {
+    auto it = entries.find(brick);
+    return (it == entries.end() ? NOT_RESIDENT : static_cast<int>(it->second.slot));
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Residency of volume bricks in a fixed number of cache slots (e.g. of a GPU brick atlas).
+ * Each frame reports bricks which have been used and bricks which are missing;
+ * missing bricks take free slots, or slots of the least recently used bricks which haven't been used in this frame.
+ */
+class BrickResidency {
+public:
+    static const int NOT_RESIDENT = -1;
+
+    // Brick to load into the slot; the brick which had the slot before (if any) is evicted.
+    struct Load {
+        size_t brick;
+        size_t slot;
+        bool evicted;
+        size_t evicted_brick;
+    };
+
+    explicit BrickResidency(size_t num_of_slots = 0);
+
+    // Evict all bricks.
+    void reset(size_t num_of_slots);
+
+    // Start a new frame: used (and requested resident) bricks become the most recently used ones,
+    // then at most max_loads missing bricks get slots, in the order of the request.
+    std::vector<Load> request(const std::vector<size_t> &used, const std::vector<size_t> &missing, size_t max_loads);
+
+    // Slot of the brick, or NOT_RESIDENT.
+    int slot(size_t brick) const;
+
+    size_t numOfSlots() const {
+        return num_of_slots;
+    }
+
+    size_t numOfResident() const {
+        return entries.size();
+    }
+
+private:
+    void touch(size_t brick);
+
+private:
+    struct Entry {
+        size_t slot;
+        size_t last_frame;
+        std::list<size_t>::iterator lru_pos;
+    };
+
+    size_t num_of_slots;
+    size_t frame {0};
+    std::list<size_t> lru; // most recently used bricks are at the front
+    std::unordered_map<size_t, Entry> entries;
+    std::vector<size_t> free_slots;
+};
@@ -0,0 +1,135 @@
+#include "brick_volume.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+size_t numOfBricks(size_t size, size_t brick_size) {
+    return (size + brick_size - 1) / brick_size;
+}
+
+}
+
+BrickVolume::BrickVolume(const Frame3D<GLfloat> &frame, size_t brick_size) :
+    brick_size(std::max(brick_size, size_t(1))),
+    brick_ranges(numOfBricks(frame.width(), this->brick_size),
+                 numOfBricks(frame.height(), this->brick_size),
+                 numOfBricks(frame.depth(), this->brick_size))
+{
+    computeRanges(frame, 0, brick_ranges.depth());
+}
+
+void BrickVolume::update(const Frame3D<GLfloat> &frame, size_t z_begin, size_t z_end) {
+    // Bricks which aprons contain the changed slices are affected too.
+    const auto bz_begin = (z_begin > 0 ? z_begin - 1 : 0) / brick_size;
+    const auto bz_end = std::min((z_end + brick_size) / brick_size, brick_ranges.depth());
+    computeRanges(frame, bz_begin, bz_end);
+}
+
+void BrickVolume::computeRanges(const Frame3D<GLfloat> &frame, size_t bz_begin, size_t bz_end) {
+    const auto w = frame.width(), h = frame.height(), d = frame.depth();
+    const auto bw = brick_ranges.width(), bh = brick_ranges.height();
+    const auto *data = frame.data();
+    const auto begin = static_cast<long long>(bz_begin), end = static_cast<long long>(bz_end);
+    #pragma omp parallel for collapse(2) schedule(dynamic)
+    for (long long bk = begin; bk < end; bk++) {
+        for (long long bj = 0; bj < static_cast<long long>(bh); bj++) {
+            const auto bz = static_cast<size_t>(bk), by = static_cast<size_t>(bj);
+            // Voxels of the brick with the apron, clamped to the frame.
+            const auto z0 = (bz*brick_size > 0 ? bz*brick_size - 1 : 0), z1 = std::min((bz + 1)*brick_size + 1, d);
+            const auto y0 = (by*brick_size > 0 ? by*brick_size - 1 : 0), y1 = std::min((by + 1)*brick_size + 1, h);
+            for (size_t bx = 0; bx < bw; bx++) {
+                const auto x0 = (bx*brick_size > 0 ? bx*brick_size - 1 : 0), x1 = std::min((bx + 1)*brick_size + 1, w);
+                auto min = std::numeric_limits<GLfloat>::max();
+                auto max = std::numeric_limits<GLfloat>::lowest();
+                for (auto z = z0; z < z1; z++) {
+                    for (auto y = y0; y < y1; y++) {
+                        const auto *row = data + (z*h + y)*w;
+                        for (auto x = x0; x < x1; x++) {
+                            min = std::min(min, row[x]);
+                            max = std::max(max, row[x]);
+                        }
+                    }
+                }
+                brick_ranges.at(bx, by, bz) = Range {min, max};
+            }
+        }
+    }
+}
+
+BrickVolume BrickVolume::dilated(size_t radius) const {
+    auto result = *this;
+    if (radius == 0) {
+        return result;
+    }
+    const size_t size[3] = {brick_ranges.width(), brick_ranges.height(), brick_ranges.depth()};
+    // Separable passes along x, y and z.
+    for (int axis = 0; axis < 3; axis++) {
+        const auto src = result.brick_ranges;
+        #pragma omp parallel for collapse(2)
+        for (long long bk = 0; bk < static_cast<long long>(size[2]); bk++) {
+            for (long long bj = 0; bj < static_cast<long long>(size[1]); bj++) {
+                for (size_t bi = 0; bi < size[0]; bi++) {
+                    size_t pos[3] = {bi, static_cast<size_t>(bj), static_cast<size_t>(bk)};
+                    const auto center = pos[axis];
+                    const auto begin = (center > radius ? center - radius : 0);
+                    const auto end = std::min(center + radius + 1, size[axis]);
+                    auto range = src.at(pos[0], pos[1], pos[2]);
+                    for (auto p = begin; p < end; p++) {
+                        pos[axis] = p;
+                        const auto &other = src.at(pos[0], pos[1], pos[2]);
+                        range.min = std::min(range.min, other.min);
+                        range.max = std::max(range.max, other.max);
+                    }
+                    pos[axis] = center;
+                    result.brick_ranges.at(pos[0], pos[1], pos[2]) = range;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+Frame3D<unsigned char> BrickVolume::occupancy(const std::vector<GLfloat> &lut, int max_step_scale, GLfloat max_activity) const {
+    Frame3D<unsigned char> result(brick_ranges.width(), brick_ranges.height(), brick_ranges.depth());
+    const auto n = static_cast<long long>(lut.size() / 4);
+    if (n == 0) {
+        result.fillBy(0);
+        return result;
+    }
+    // Prefix count of entries with non-zero opacity and prefix sum of opacity differences between neighbouring entries:
+    // any range of entries is tested in constant time.
+    std::vector<size_t> prefix(static_cast<size_t>(n) + 1, 0);
+    std::vector<double> variation(static_cast<size_t>(n), 0.0);
+    for (size_t i = 0; i < static_cast<size_t>(n); i++) {
+        prefix[i + 1] = prefix[i] + (lut[i*4 + 3] > 0.0f ? 1 : 0);
+        if (i > 0) {
+            variation[i] = variation[i - 1] + std::abs(static_cast<double>(lut[i*4 + 3] - lut[(i - 1)*4 + 3]));
+        }
+    }
+    const auto max_scale = std::min(std::max(max_step_scale, 1), 255);
+    // Entries which linear filtering of the table mixes for a value (texel centers are at (i + 0.5)/n).
+    auto entry = [n](GLfloat value) {
+        const auto i = static_cast<long long>(std::floor(static_cast<double>(value) * static_cast<double>(n) - 0.5));
+        return std::min(std::max(i, 0LL), n - 1);
+    };
+    const auto *ranges = brick_ranges.data();
+    auto *occupied = result.data();
+    const auto size = static_cast<long long>(result.size());
+    #pragma omp parallel for
+    for (long long i = 0; i < size; i++) {
+        const auto &range = ranges[i];
+        const auto first = static_cast<size_t>(entry(range.min));
+        const auto last = static_cast<size_t>(std::min(entry(range.max) + 1, n - 1));
+        if (prefix[last + 1] == prefix[first]) {
+            occupied[i] = 0;
+            continue;
+        }
+        const auto activity = variation[last] - variation[first];
+        const auto scale = (activity > 0.0 ? static_cast<double>(max_activity) / activity : static_cast<double>(max_scale));
+        occupied[i] = static_cast<unsigned char>(std::min(std::max(static_cast<int>(scale), 1), max_scale));
+    }
+    return result;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "frame3d.h"
+
+#include <QOpenGLFunctions>
+
+#include <vector>
+
+/*
+ * Low-resolution volume of value ranges over bricks of brick_size^3 voxels.
+ * Each range also covers the one-voxel apron around the brick, so it bounds every value
+ * which trilinear interpolation can produce at positions inside the brick.
+ * Combined with a transfer function, it tells which bricks can be skipped by the ray caster.
+ */
+class BrickVolume {
+public:
+    struct Range {
+        GLfloat min, max;
+    };
+
+    BrickVolume(const Frame3D<GLfloat> &frame, size_t brick_size = 8);
+
+    // Recompute ranges of bricks affected by a change of frame slices [z_begin, z_end).
+    void update(const Frame3D<GLfloat> &frame, size_t z_begin, size_t z_end);
+
+    // Occupancy of each brick by the RGBA lookup table (see TransferFunction::lookupTable):
+    // 0 if no value of the brick range can have non-zero opacity, otherwise the sampling step scale
+    // in [1, max_step_scale]. Activity of a brick is the total variation of opacity over its value range
+    // (value range times opacity derivative); the less it is, the longer steps can be taken in the brick.
+    Frame3D<unsigned char> occupancy(const std::vector<GLfloat> &lut, int max_step_scale = 1,
+                                     GLfloat max_activity = 0.1f) const;
+
+    // Copy with each range merged with the ranges of bricks up to 'radius' bricks away along each axis,
+    // so it bounds values filtered over a larger footprint than the apron (e.g. sampled from coarser mip levels).
+    BrickVolume dilated(size_t radius) const;
+
+    size_t brickSize() const {
+        return brick_size;
+    }
+
+    const Frame3D<Range>& ranges() const {
+        return brick_ranges;
+    }
+
+private:
+    void computeRanges(const Frame3D<GLfloat> &frame, size_t bz_begin, size_t bz_end);
+
+private:
+    size_t brick_size;
+    Frame3D<Range> brick_ranges;
+};
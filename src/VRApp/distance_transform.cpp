@@ -0,0 +1,122 @@
+#include "distance_transform.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace {
+
+// Squared distance of voxels which no feature voxel reaches; its root is NO_DISTANCE.
+const float INF = NO_DISTANCE * NO_DISTANCE;
+
+// Number of neighbouring lines processed together, so strided passes read memory by contiguous runs.
+const size_t LINE_BLOCK = 16;
+
+// 1D squared distance transform of the sampled function f (lower envelope of parabolas).
+// v, z are scratch buffers of size n and n + 1.
+void squaredDistance1D(const float *f, float *d, size_t n, std::vector<size_t> &v, std::vector<double> &z) {
+    if (std::all_of(f, f + n, [](float value) {return value >= INF;})) {
+        std::fill(d, d + n, INF); // nothing to propagate along this line
+        return;
+    }
+    size_t k = 0;
+    v[0] = 0;
+    z[0] = -INF;
+    z[1] = INF;
+    for (size_t q = 1; q < n; q++) {
+        const auto fq = double(f[q]) + double(q)*double(q);
+        auto s = (fq - (double(f[v[k]]) + double(v[k])*double(v[k]))) / (2.0*double(q) - 2.0*double(v[k]));
+        while (s <= z[k]) {
+            k--;
+            s = (fq - (double(f[v[k]]) + double(v[k])*double(v[k]))) / (2.0*double(q) - 2.0*double(v[k]));
+        }
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = INF;
+    }
+    k = 0;
+    for (size_t q = 0; q < n; q++) {
+        while (z[k + 1] < double(q)) {
+            k++;
+        }
+        const auto diff = double(q) - double(v[k]);
+        d[q] = static_cast<float>(std::min(diff*diff + double(f[v[k]]), double(INF)));
+    }
+}
+
+// Apply 1D transform of length n to all lines of the frame.
+// Line (a, b) starts at a*a_step + b*b_step and has elements at the given stride.
+void transformLines(std::vector<float> &data, size_t n, size_t stride,
+                    size_t num_a, size_t a_step, size_t num_b, size_t b_step) {
+    // Neighbouring lines are gathered together only if they are adjacent in memory.
+    const auto block = (a_step == 1 ? LINE_BLOCK : 1);
+    const auto num_blocks = (num_a + block - 1) / block;
+    #pragma omp parallel
+    {
+        std::vector<float> f(n*block), d(n);
+        std::vector<double> z(n + 1);
+        std::vector<size_t> v(n);
+        #pragma omp for collapse(2)
+        for (size_t b = 0; b < num_b; b++) {
+            for (size_t ab = 0; ab < num_blocks; ab++) {
+                const auto a0 = ab*block;
+                const auto count = std::min(block, num_a - a0);
+                const auto start = a0*a_step + b*b_step;
+                for (size_t i = 0; i < n; i++) {
+                    for (size_t t = 0; t < count; t++) {
+                        f[t*n + i] = data[start + t*a_step + i*stride];
+                    }
+                }
+                for (size_t t = 0; t < count; t++) {
+                    squaredDistance1D(&f[t*n], d.data(), n, v, z);
+                    std::copy(d.begin(), d.end(), f.begin() + static_cast<std::ptrdiff_t>(t*n));
+                }
+                for (size_t i = 0; i < n; i++) {
+                    for (size_t t = 0; t < count; t++) {
+                        data[start + t*a_step + i*stride] = f[t*n + i];
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Squared distances are integers, so they are exact in float for volumes up to ~2000^3.
+std::vector<float> squaredDistance(const Mask3D &mask, bool feature_value) {
+    const auto w = mask.width(), h = mask.height(), dp = mask.depth();
+    std::vector<float> data(mask.size());
+    const auto *m = mask.data();
+    #pragma omp parallel for
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = ((m[i] != 0) == feature_value ? 0.0f : INF);
+    }
+    // Frame layout is [z][y][x], see Frame3D::index.
+    transformLines(data, w, 1, h, w, dp, w*h); // along x
+    transformLines(data, h, w, w, 1, dp, w*h); // along y
+    transformLines(data, dp, w*h, w, 1, h, w); // along z
+    return data;
+}
+}
+
+Frame3D<GLfloat> signedDistanceField(const Mask3D &inside) {
+    const auto dist_out = squaredDistance(inside, true); // distance to the nearest inside voxel
+    const auto dist_in = squaredDistance(inside, false); // distance to the nearest outside voxel
+    Frame3D<GLfloat> frame(inside.width(), inside.height(), inside.depth());
+    auto *out = frame.data();
+    #pragma omp parallel for
+    for (size_t i = 0; i < dist_out.size(); i++) {
+        out[i] = static_cast<GLfloat>(dist_out[i] > 0.0 ? std::sqrt(dist_out[i]) - 0.5f : 0.5f - std::sqrt(dist_in[i]));
+    }
+    return frame;
+}
+
+Frame3D<GLfloat> makeShellFrame(const Frame3D<GLfloat> &sdf, double thickness) {
+    Frame3D<GLfloat> frame(sdf.width(), sdf.height(), sdf.depth());
+    frame.fill([&](size_t i, size_t j, size_t k) -> auto {
+        const auto diff = std::abs(static_cast<double>(sdf.at(i, j, k)));
+        return diff <= thickness ? 1.0 - diff/thickness : 0.0;
+    });
+    return frame;
+}
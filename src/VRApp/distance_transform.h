@@ -0,0 +1,26 @@
+#pragma once
+
+#include "frame3d.h"
+
+#include <QOpenGLFunctions>
+
+/*
+ * Exact Euclidean distance transforms (in voxels) over 3D frames.
+ * Implemented as separable 1D lower envelope passes (Felzenszwalb & Huttenlocher),
+ * so cost is linear in the number of voxels and each pass runs in parallel over lines.
+ */
+
+using Mask3D = Frame3D<unsigned char>;
+
+// Distances which have no voxel to be measured to (e.g. all distances of an empty mask) are NO_DISTANCE,
+// farther than any voxel of a frame, so they compare and threshold like a very long distance.
+const GLfloat NO_DISTANCE = 1e10f;
+
+// Signed distance to the boundary of the mask: negative inside, positive outside.
+// Boundary is placed halfway between inside and outside voxels; without one (the mask is empty or full)
+// distances are about NO_DISTANCE with the sign of the side.
+Frame3D<GLfloat> signedDistanceField(const Mask3D &inside);
+
+// Shell of the given thickness (in voxels) around the zero level of the signed distance field.
+// Values fall linearly from 1 on the surface to 0 at the shell border.
+Frame3D<GLfloat> makeShellFrame(const Frame3D<GLfloat> &sdf, double thickness);
@@ -0,0 +1,159 @@
+#include "frame_cache.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+
+#include <cstring>
+#include <sstream>
+
+namespace {
+
+const char CACHE_FILE_MAGIC[4] = {'V', 'F', 'C', 'F'};
+const std::uint32_t CACHE_FILE_VERSION = 1;
+
+// Header is padded to 64 bytes so the data which follows it is aligned when the file is mapped.
+struct CacheFileHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint64_t width, height, depth;
+    unsigned char reserved[32];
+};
+
+static_assert(sizeof(CacheFileHeader) == 64, "Cache file header should be 64 bytes");
+
+size_t frameBytes(const Frame3D<GLfloat> &frame) {
+    return frame.size() * sizeof(GLfloat);
+}
+
+}
+
+FrameCache::FrameCache(size_t byte_budget) :
+    byte_budget(byte_budget)
+{
+}
+
+std::string FrameCache::makeKey(const std::string &generator, const std::vector<double> &params,
+                                size_t size, std::uint64_t seed) {
+    std::ostringstream out;
+    out.precision(17);
+    out << generator << ":" << size << ":" << seed;
+    for (const auto &p: params) {
+        out << ":" << p;
+    }
+    return out.str();
+}
+
+FrameCache::FramePtr FrameCache::get(const std::string &key, Generator generator) {
+    auto frame = find(key);
+    if (!frame) {
+        frame = std::make_shared<const Frame3D<GLfloat>>(generator());
+        put(key, frame);
+    }
+    return frame;
+}
+
+FrameCache::FramePtr FrameCache::find(const std::string &key) {
+    auto it = cache_map.find(key);
+    if (it != cache_map.end()) {
+        cache_list.splice(cache_list.begin(), cache_list, it->second);
+        return it->second->second;
+    }
+    auto frame = loadFromDisk(key);
+    if (frame) {
+        putInMemory(key, frame);
+    }
+    return frame;
+}
+
+void FrameCache::put(const std::string &key, FramePtr frame) {
+    putInMemory(key, frame);
+    saveToDisk(key, *frame);
+}
+
+void FrameCache::putInMemory(const std::string &key, FramePtr frame) {
+    auto it = cache_map.find(key);
+    if (it != cache_map.end()) {
+        bytes_used -= frameBytes(*(it->second->second));
+        cache_list.erase(it->second);
+        cache_map.erase(it);
+    }
+    cache_list.emplace_front(key, frame);
+    cache_map[key] = cache_list.begin();
+    bytes_used += frameBytes(*frame);
+    evict();
+}
+
+void FrameCache::evict() {
+    // The most recent frame is kept even if it alone exceeds the budget: it is in use anyway.
+    while (bytes_used > byte_budget && cache_list.size() > 1) {
+        bytes_used -= frameBytes(*(cache_list.back().second));
+        cache_map.erase(cache_list.back().first);
+        cache_list.pop_back();
+    }
+}
+
+void FrameCache::setByteBudget(size_t budget) {
+    byte_budget = budget;
+    evict();
+}
+
+void FrameCache::clear() {
+    cache_list.clear();
+    cache_map.clear();
+    bytes_used = 0;
+}
+
+std::string FrameCache::diskPath(const std::string &key) const {
+    const auto hash = QCryptographicHash::hash(QByteArray::fromStdString(key), QCryptographicHash::Sha1).toHex();
+    return QDir(QString::fromStdString(disk_dir)).filePath(QString(hash) + ".vfc").toStdString();
+}
+
+FrameCache::FramePtr FrameCache::loadFromDisk(const std::string &key) const {
+    if (disk_dir.empty()) {
+        return nullptr;
+    }
+    QFile file(QString::fromStdString(diskPath(key)));
+    if (!file.open(QIODevice::ReadOnly) || file.size() < static_cast<qint64>(sizeof(CacheFileHeader))) {
+        return nullptr;
+    }
+    auto *mem = file.map(0, file.size());
+    if (!mem) {
+        return nullptr;
+    }
+    CacheFileHeader header;
+    std::memcpy(&header, mem, sizeof(header));
+    const auto num_of_values = header.width * header.height * header.depth;
+    FramePtr result;
+    if (std::memcmp(header.magic, CACHE_FILE_MAGIC, sizeof(header.magic)) == 0 &&
+            header.version == CACHE_FILE_VERSION &&
+            static_cast<qint64>(sizeof(header) + num_of_values * sizeof(GLfloat)) == file.size()) {
+        auto frame = std::make_shared<Frame3D<GLfloat>>(header.width, header.height, header.depth);
+        std::memcpy(frame->data(), mem + sizeof(header), num_of_values * sizeof(GLfloat));
+        result = frame;
+    }
+    file.unmap(mem);
+    return result;
+}
+
+void FrameCache::saveToDisk(const std::string &key, const Frame3D<GLfloat> &frame) const {
+    if (disk_dir.empty() || !QDir().mkpath(QString::fromStdString(disk_dir))) {
+        return;
+    }
+    CacheFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, CACHE_FILE_MAGIC, sizeof(header.magic));
+    header.version = CACHE_FILE_VERSION;
+    header.width = frame.width();
+    header.height = frame.height();
+    header.depth = frame.depth();
+    // Write to a temporary file first, so a partial file is never seen under the final name.
+    QSaveFile file(QString::fromStdString(diskPath(key)));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(frame.data()), static_cast<qint64>(frameBytes(frame)));
+    file.commit();
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "frame3d.h"
+
+#include <QOpenGLFunctions>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Cache of generated frames keyed by generator parameters.
+ * Frames are kept in memory in LRU order within a byte budget and can be persisted on disk.
+ * Disk files are a fixed-size header followed by raw float data, so they can be memory-mapped.
+ */
+class FrameCache {
+public:
+    using FramePtr = std::shared_ptr<const Frame3D<GLfloat>>;
+    using Generator = std::function<Frame3D<GLfloat>()>;
+
+    explicit FrameCache(size_t byte_budget = 512*1024*1024);
+
+    static std::string makeKey(const std::string &generator, const std::vector<double> &params,
+                               size_t size, std::uint64_t seed = 0);
+
+    // Cached frame for the key, or result of the generator (which is then cached).
+    FramePtr get(const std::string &key, Generator generator);
+
+    // Cached frame for the key (from memory or disk), or nullptr.
+    FramePtr find(const std::string &key);
+
+    void put(const std::string &key, FramePtr frame);
+
+    void setByteBudget(size_t budget);
+
+    size_t byteBudget() const {
+        return byte_budget;
+    }
+
+    size_t bytesUsed() const {
+        return bytes_used;
+    }
+
+    // Directory for persistent cache files; empty string disables persistence.
+    void setDiskDir(const std::string &dir) {
+        disk_dir = dir;
+    }
+
+    void clear();
+
+private:
+    void putInMemory(const std::string &key, FramePtr frame);
+    void evict();
+
+    std::string diskPath(const std::string &key) const;
+    FramePtr loadFromDisk(const std::string &key) const;
+    void saveToDisk(const std::string &key, const Frame3D<GLfloat> &frame) const;
+
+private:
+    using CacheList = std::list<std::pair<std::string, FramePtr>>;
+    CacheList cache_list; // most recently used frames are at the front
+    std::unordered_map<std::string, CacheList::iterator> cache_map;
+    size_t byte_budget;
+    size_t bytes_used {0};
+    std::string disk_dir;
+};
@@ -1,37 +1,146 @@
 #include "frame_loader.h"
 
+#include <algorithm>
+#include <cmath>
 #include <fstream>
+#include <limits>
 #include <sstream>
+#include <stdexcept>
+#include <vector>
 
 namespace {
 
-template <ValueType Type>
-Frame3D<GLfloat> readFrame(std::ifstream &in, size_t width, size_t height, size_t depth) {
-    using InputType = typename ValueTypeSelect<Type>::type;
-    const auto size = width * height * depth;
-    if (size == 0) {
+void checkSize(size_t width, size_t height, size_t depth) {
+    if (width * height * depth == 0) {
         std::ostringstream out;
         out << "Bad data size: " << width << " x " << height << " x " << depth;
         throw std::runtime_error(out.str());
     }
-    std::vector<InputType> values(size);
+}
+
+// Same as Frame3D::normalize(), but by the given range of values.
+void normalizeFrame(Frame3D<GLfloat> &frame, double min, double max) {
+    min = std::min(0.0, min);
+    if (std::abs(max - min) >= 1e-8) {
+        const auto coeff = 1.0 / (max - min);
+        auto *data = frame.data();
+        #pragma omp parallel for
+        for (long long i = 0; i < static_cast<long long>(frame.size()); i++) {
+            data[i] = static_cast<GLfloat>(data[i] * coeff);
+        }
+    }
+}
+
+template <ValueType Type>
+Frame3D<GLfloat> readFrame(std::ifstream &in, size_t width, size_t height, size_t depth, size_t factor) {
+    using InputType = typename ValueTypeSelect<Type>::type;
+    checkSize(width, height, depth);
+
+    // Data is read by slices; each block of factor^3 voxels is averaged into one voxel of the frame.
+    const auto frame_width = (width + factor - 1) / factor;
+    const auto frame_height = (height + factor - 1) / factor;
+    const auto frame_depth = (depth + factor - 1) / factor;
+    Frame3D<GLfloat> frame(frame_width, frame_height, frame_depth);
+    std::vector<InputType> slice(width * height);
+    std::vector<double> sums(frame_width * frame_height, 0.0);
+    auto min = std::numeric_limits<double>::max();
+    auto max = std::numeric_limits<double>::lowest();
+
     in.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-    try {
-        in.read(reinterpret_cast<char *>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(InputType)));
+    for (size_t z = 0; z < depth; z++) {
+        try {
+            in.read(reinterpret_cast<char *>(slice.data()), static_cast<std::streamsize>(slice.size() * sizeof(InputType)));
+        }
+        catch (const std::ifstream::failure &e) {
+            throw std::runtime_error(std::string("Failed to read data: ") + e.what());
+        }
+
+        // Each thread sums its own rows of blocks.
+        #pragma omp parallel for reduction(min: min) reduction(max: max)
+        for (long long by = 0; by < static_cast<long long>(frame_height); by++) {
+            auto *block_sums = &sums[static_cast<size_t>(by) * frame_width];
+            const auto y_end = std::min((static_cast<size_t>(by) + 1) * factor, height);
+            for (auto y = static_cast<size_t>(by) * factor; y < y_end; y++) {
+                const auto *row = &slice[y * width];
+                for (size_t x = 0; x < width; x++) {
+                    const auto value = static_cast<double>(row[x]);
+                    min = std::min(min, value);
+                    max = std::max(max, value);
+                    block_sums[x / factor] += value;
+                }
+            }
+        }
+
+        if ((z + 1) % factor == 0 || z + 1 == depth) {
+            const auto block_depth = z % factor + 1;
+            auto *dest = frame.data() + (z / factor) * frame_width * frame_height;
+            #pragma omp parallel for
+            for (long long by = 0; by < static_cast<long long>(frame_height); by++) {
+                const auto y = static_cast<size_t>(by);
+                const auto block_height = std::min(factor, height - y * factor);
+                for (size_t bx = 0; bx < frame_width; bx++) {
+                    const auto block_width = std::min(factor, width - bx * factor);
+                    auto &sum = sums[y * frame_width + bx];
+                    dest[y * frame_width + bx] = static_cast<GLfloat>(sum / static_cast<double>(block_width * block_height * block_depth));
+                    sum = 0.0;
+                }
+            }
+        }
     }
-    catch (const std::ifstream::failure &e) {
-        throw std::runtime_error(std::string("Failed to read data: ") + e.what());
+
+    // Normalized by the range of the original data.
+    normalizeFrame(frame, min, max);
+    return frame;
+}
+
+template <ValueType Type>
+Frame3D<GLfloat> readStridedFrame(std::ifstream &in, size_t width, size_t height, size_t depth, size_t stride) {
+    using InputType = typename ValueTypeSelect<Type>::type;
+    checkSize(width, height, depth);
+
+    // Only every stride-th row of every stride-th slice is read, the rest of the file is skipped.
+    const auto frame_width = (width + stride - 1) / stride;
+    const auto frame_height = (height + stride - 1) / stride;
+    const auto frame_depth = (depth + stride - 1) / stride;
+    Frame3D<GLfloat> frame(frame_width, frame_height, frame_depth);
+    std::vector<InputType> row(width);
+    auto min = std::numeric_limits<double>::max();
+    auto max = std::numeric_limits<double>::lowest();
+
+    in.exceptions (std::ifstream::failbit | std::ifstream::badbit);
+    const auto start = in.tellg();
+    for (size_t z = 0; z < frame_depth; z++) {
+        for (size_t y = 0; y < frame_height; y++) {
+            const auto offset = ((z * stride * height) + y * stride) * width * sizeof(InputType);
+            try {
+                in.seekg(start + static_cast<std::streamoff>(offset));
+                in.read(reinterpret_cast<char *>(row.data()), static_cast<std::streamsize>(row.size() * sizeof(InputType)));
+            }
+            catch (const std::ifstream::failure &e) {
+                throw std::runtime_error(std::string("Failed to read data: ") + e.what());
+            }
+            for (size_t x = 0; x < frame_width; x++) {
+                const auto value = static_cast<double>(row[x * stride]);
+                min = std::min(min, value);
+                max = std::max(max, value);
+                frame.at(x, y, z) = static_cast<GLfloat>(value);
+            }
+        }
     }
 
-    Frame3D<GLfloat> frame(width, height, depth);
-    frame.fill(values.begin(), values.end()); // load data 'as is' into frame
-    frame.normalize();
+    // Range of the samples only; it's refined when the whole data is read.
+    normalizeFrame(frame, min, max);
     return frame;
 }
 
+template <ValueType Type>
+Frame3D<GLfloat> readData(std::ifstream &in, size_t width, size_t height, size_t depth, size_t factor, bool strided) {
+    return (strided ? readStridedFrame<Type>(in, width, height, depth, factor) : readFrame<Type>(in, width, height, depth, factor));
+}
+
 }
 
-Frame3D<GLfloat> FrameLoader::load(const std::string &filename) {
+Frame3D<GLfloat> FrameLoader::load(const std::string &filename, const LoadPolicy &policy, LoadInfo *info) {
     std::ifstream in(filename.c_str(), std::ios_base::in | std::ios_base::binary);
     if (!in.is_open()) {
         throw std::runtime_error("Cannot open file " + filename);
@@ -48,33 +157,61 @@ Frame3D<GLfloat> FrameLoader::load(const std::string &filename) {
     catch (const std::ifstream::failure &e) {
         throw std::runtime_error(std::string("Failed to read data: ") + e.what());
     }
-    return loadBinary(in, width, height, depth, static_cast<ValueType>(type));
+    return loadBinary(in, width, height, depth, static_cast<ValueType>(type), policy, info);
 }
 
-Frame3D<GLfloat> FrameLoader::loadRaw(const std::string &filename, size_t width, size_t height, size_t depth, ValueType type) {
+Frame3D<GLfloat> FrameLoader::loadRaw(const std::string &filename, size_t width, size_t height, size_t depth, ValueType type,
+                                      const LoadPolicy &policy, LoadInfo *info) {
     std::ifstream in(filename.c_str(), std::ios_base::in | std::ios_base::binary);
     if (!in.is_open()) {
         throw std::runtime_error("Cannot open file " + filename);
     }
-    return loadBinary(in, width, height, depth, type);
+    return loadBinary(in, width, height, depth, type, policy, info);
 }
 
-Frame3D<GLfloat> FrameLoader::loadBinary(std::ifstream &in, size_t width, size_t height, size_t depth, ValueType type) {
+size_t FrameLoader::decimationFactor(size_t width, size_t height, size_t depth, const LoadPolicy &policy) {
+    for (size_t factor = std::max<size_t>(policy.min_factor, 1); ; factor++) {
+        const auto w = (width + factor - 1) / factor;
+        const auto h = (height + factor - 1) / factor;
+        const auto d = (depth + factor - 1) / factor;
+        const auto voxels = static_cast<double>(w * h * d);
+        const auto fits_host = (policy.host_budget == 0 ||
+                                voxels * policy.host_bytes_per_voxel <= static_cast<double>(policy.host_budget));
+        const auto fits_gpu = (policy.gpu_budget == 0 ||
+                               voxels * policy.gpu_bytes_per_voxel <= static_cast<double>(policy.gpu_budget));
+        const auto fits_texture = (policy.max_texture_size == 0 ||
+                                   std::max(w, std::max(h, d)) <= policy.max_texture_size);
+        if ((fits_host && fits_gpu && fits_texture) || (w == 1 && h == 1 && d == 1)) {
+            return factor;
+        }
+    }
+}
+
+Frame3D<GLfloat> FrameLoader::loadBinary(std::ifstream &in, size_t width, size_t height, size_t depth, ValueType type,
+                                         const LoadPolicy &policy, LoadInfo *info) {
+    const auto factor = decimationFactor(width, height, depth, policy);
+    if (info) {
+        info->width = width;
+        info->height = height;
+        info->depth = depth;
+        info->factor = factor;
+    }
+    const auto strided = (policy.strided && factor > 1);
     switch (type) {
     case ValueType::VT_INT8:
-        return readFrame<ValueType::VT_INT8>(in, width, height, depth);
+        return readData<ValueType::VT_INT8>(in, width, height, depth, factor, strided);
     case ValueType::VT_UINT8:
-        return readFrame<ValueType::VT_UINT8>(in, width, height, depth);
+        return readData<ValueType::VT_UINT8>(in, width, height, depth, factor, strided);
     case ValueType::VT_INT16:
-        return readFrame<ValueType::VT_INT16>(in, width, height, depth);
+        return readData<ValueType::VT_INT16>(in, width, height, depth, factor, strided);
     case ValueType::VT_UINT16:
-        return readFrame<ValueType::VT_UINT16>(in, width, height, depth);
+        return readData<ValueType::VT_UINT16>(in, width, height, depth, factor, strided);
     case ValueType::VT_INT32:
-        return readFrame<ValueType::VT_UINT32>(in, width, height, depth);
+        return readData<ValueType::VT_UINT32>(in, width, height, depth, factor, strided);
     case ValueType::VT_UINT32:
-        return readFrame<ValueType::VT_UINT32>(in, width, height, depth);
+        return readData<ValueType::VT_UINT32>(in, width, height, depth, factor, strided);
     case ValueType::VT_FLOAT:
-        return readFrame<ValueType::VT_FLOAT>(in, width, height, depth);
+        return readData<ValueType::VT_FLOAT>(in, width, height, depth, factor, strided);
     default:
         throw std::runtime_error("Unknown data type: " + std::to_string((int)type));
     }
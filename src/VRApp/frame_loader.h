@@ -8,11 +8,38 @@
 #include <cstddef>
 #include <fstream>
 
+// Limits for loaded frames; zero means no limit.
+struct LoadPolicy {
+    size_t host_budget {0}; // bytes of the frame and the data derived from it in host memory
+    size_t gpu_budget {0}; // bytes of the textures of the frame
+    // Memory per voxel of the frame which the budgets are compared to. By default it's just the frame,
+    // and the data texture with its mip levels (1/7 more); the viewer adds what it derives (pyramid, gradient, ...).
+    double host_bytes_per_voxel {sizeof(GLfloat)};
+    double gpu_bytes_per_voxel {sizeof(GLfloat) * 8.0 / 7.0};
+    size_t max_texture_size {0}; // max size of a 3D texture along any axis (GL_MAX_3D_TEXTURE_SIZE)
+    size_t min_factor {1}; // data is decimated at least by this factor
+    // Decimated data is sampled (every factor-th voxel) instead of averaged, so only the sampled rows are read;
+    // time to load is then nearly independent of the file size.
+    bool strided {false};
+};
+
+// What has actually been loaded.
+struct LoadInfo {
+    size_t width {0}, height {0}, depth {0}; // size of the data in the file
+    size_t factor {1}; // each voxel of the frame is the average (or a sample if strided) of (up to) factor^3 voxels of the file
+};
+
 class FrameLoader {
 public:
-    static Frame3D<GLfloat> load(const std::string &filename);
-    static Frame3D<GLfloat> loadRaw(const std::string &filename, size_t width, size_t height, size_t depth, ValueType type);
+    // Data which doesn't fit the policy is decimated while it's read, so the full-resolution frame is never in memory.
+    static Frame3D<GLfloat> load(const std::string &filename, const LoadPolicy &policy = LoadPolicy(), LoadInfo *info = nullptr);
+    static Frame3D<GLfloat> loadRaw(const std::string &filename, size_t width, size_t height, size_t depth, ValueType type,
+                                    const LoadPolicy &policy = LoadPolicy(), LoadInfo *info = nullptr);
+
+    // Smallest decimation factor (the same along all axes, to keep the aspect) which makes data fit the policy.
+    static size_t decimationFactor(size_t width, size_t height, size_t depth, const LoadPolicy &policy);
 
 private:
-    static Frame3D<GLfloat> loadBinary(std::ifstream &in, size_t width, size_t height, size_t depth, ValueType type);
+    static Frame3D<GLfloat> loadBinary(std::ifstream &in, size_t width, size_t height, size_t depth, ValueType type,
+                                       const LoadPolicy &policy, LoadInfo *info);
 };
@@ -1,12 +1,15 @@
 #include "frame_util.h"
+#include "philox.h"
+#include "distance_transform.h"
 #include "../common/types.h"
 
 #include <algorithm>
 #include <cmath>
-#include <random>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
 #include <utility>
 #include <vector>
-#include <ctime>
 #include <fstream>
 
 namespace  {
@@ -107,34 +110,61 @@ namespace  {
                                lerp(u, grad(perm[(AB + 1) % perm.size()], x, y - 1, z - 1),
                                        grad(perm[(BB + 1) % perm.size()], x - 1, y - 1, z - 1))));
     }
+
+    // Streams of the counter-based generator, so different uses of one seed do not correlate.
+    enum RandomStream : std::uint32_t {
+        RS_VOXELS = 0,
+        RS_BUBBLES,
+        RS_PERMUTATIONS
+    };
+
+    std::vector<size_t> randomPermutations(size_t size, std::uint64_t seed) {
+        std::vector<size_t> permutations;
+        for (size_t i = 0; i < size; i++) {
+            permutations.push_back(i);
+        }
+        // Fisher-Yates shuffle driven by the counter-based generator (platform-independent).
+        const Philox4x32 rng(seed);
+        for (size_t i = size - 1; i > 0; i--) {
+            const auto j = rng(i, RS_PERMUTATIONS)[0] % (i + 1);
+            std::swap(permutations[i], permutations[j]);
+        }
+        return permutations;
+    }
+
+    ProceduralSourcePtr makeSource(size_t dim_size, ProceduralVolumeSource::Func func) {
+        return std::make_shared<ProceduralVolumeSource>(dim_size, dim_size, dim_size, func);
+    }
+
+    std::function<double(double,double,double)> torusFunction(double R, double r) {
+        return [R, r](double x, double y, double z) {
+            const auto tmp = (x*x + y*y + z*z + R*R - r*r);
+            return tmp*tmp - 4*R*R*(x*x + y*y);
+        };
+    }
 }
 
-Frame3D<GLfloat> makeRandomFrame(size_t dim_size) {
-    //std::random_device rd;
-    std::mt19937 mt(static_cast<unsigned int>(time(nullptr)));
-    std::uniform_real_distribution<GLfloat> distribution(0.0f, 1.0f);
-    Frame3D<GLfloat> frame(dim_size, dim_size, dim_size);
-    frame.fill([&](size_t, size_t, size_t) -> auto {
-        return distribution(mt);
+ProceduralSourcePtr makeRandomSource(size_t dim_size, std::uint64_t seed) {
+    // Each voxel draws from its own counter (its index), so the result does not depend on the number of threads.
+    const Philox4x32 rng(seed);
+    return makeSource(dim_size, [rng, dim_size](size_t i, size_t j, size_t k) -> double {
+        return rng.uniform((k*dim_size + j)*dim_size + i, RS_VOXELS);
     });
-    return frame;
 }
 
-Frame3D<GLfloat> makeSectorFrame(size_t dim_size) {
-    Frame3D<GLfloat> frame(dim_size, dim_size, dim_size);
-    frame.fill([&](size_t i, size_t j, size_t k) -> auto {
-        const auto x = double(i) / (frame.width() - 1);
-        const auto y = double(j) / (frame.height() - 1);
-        const auto z = double(k) / (frame.depth() - 1);
+ProceduralSourcePtr makeSectorSource(size_t dim_size) {
+    const auto coeff = 1.0 / (dim_size - 1);
+    return makeSource(dim_size, [coeff](size_t i, size_t j, size_t k) -> double {
+        const auto x = double(i) * coeff;
+        const auto y = double(j) * coeff;
+        const auto z = double(k) * coeff;
         return std::sqrt(x*x + y*y + z*z) / std::sqrt(3.0);
     });
-    return frame;
 }
 
-Frame3D<GLfloat> makeSphereFrame(size_t dim_size) {
-    Frame3D<GLfloat> frame(dim_size, dim_size, dim_size);
+ProceduralSourcePtr makeSphereSource(size_t dim_size) {
     const auto coeff = 2.0 / (dim_size - 1);
-    frame.fill([&](size_t i, size_t j, size_t k) -> auto {
+    return makeSource(dim_size, [coeff](size_t i, size_t j, size_t k) -> double {
         const auto x = 1.0 - double(i) * coeff;
         const auto y = 1.0 - double(j) * coeff;
         const auto z = 1.0 - double(k) * coeff;
@@ -144,14 +174,12 @@ Frame3D<GLfloat> makeSphereFrame(size_t dim_size) {
         const auto dist = std::sqrt(x*x + y*y + z*z);
         return lessOrEqual(dist, 1.0) ? 1.0 - dist : 0.0;
     });
-    return frame;
 }
 
-Frame3D<GLfloat> makeAnalyticalSurfaceFrame(size_t dim_size, double cutoff,
-                                            std::function<double (double, double)> surface_func) {
-    Frame3D<GLfloat> frame(dim_size, dim_size, dim_size);
+ProceduralSourcePtr makeAnalyticalSurfaceSource(size_t dim_size, double cutoff,
+                                                std::function<double (double, double)> surface_func) {
     const auto coeff = 2.0 / (dim_size - 1);
-    frame.fill([&](size_t i, size_t j, size_t k) -> auto {
+    return makeSource(dim_size, [coeff, cutoff, surface_func](size_t i, size_t j, size_t k) -> double {
         const auto x = 1.0 - double(i) * coeff;
         const auto y = 1.0 - double(j) * coeff;
         const auto z = 1.0 - double(k) * coeff;
@@ -159,14 +187,12 @@ Frame3D<GLfloat> makeAnalyticalSurfaceFrame(size_t dim_size, double cutoff,
         const auto diff = std::abs(z - func_value);
         return lessOrEqual(diff, cutoff) ? 1.0 - diff/cutoff : 0.0;
     });
-    return frame;
 }
 
-Frame3D<GLfloat> makeImplicitSurfaceFrame(size_t dim_size, double cutoff,
-                                           std::function<double (double, double, double)> surface_func) {
-    Frame3D<GLfloat> frame(dim_size, dim_size, dim_size);
+ProceduralSourcePtr makeImplicitSurfaceSource(size_t dim_size, double cutoff,
+                                              std::function<double (double, double, double)> surface_func) {
     const auto coeff = 2.0/(dim_size - 1);
-    frame.fill([&](size_t i, size_t j, size_t k) -> auto {
+    return makeSource(dim_size, [coeff, cutoff, surface_func](size_t i, size_t j, size_t k) -> double {
         const auto x = 1.0 - double(i) * coeff;
         const auto y = 1.0 - double(j) * coeff;
         const auto z = 1.0 - double(k) * coeff;
@@ -175,64 +201,61 @@ Frame3D<GLfloat> makeImplicitSurfaceFrame(size_t dim_size, double cutoff,
         const auto diff = std::abs(func_value);
         return lessOrEqual(diff, cutoff) ? 1.0 - diff/cutoff : 0.0;
     });
-    return frame;
 }
 
-Frame3D<GLfloat> makeParaboloidFrame(size_t dim_size, double cutoff) {
-    return makeImplicitSurfaceFrame(dim_size, cutoff, [](auto x, auto y, auto z) {
+ProceduralSourcePtr makeParaboloidSource(size_t dim_size, double cutoff) {
+    return makeImplicitSurfaceSource(dim_size, cutoff, [](auto x, auto y, auto z) {
         return x*x + y*y - z;
     });
 }
 
-Frame3D<GLfloat> makeHyperboloidFrame(size_t dim_size, double cutoff) {
-    return makeImplicitSurfaceFrame(dim_size, cutoff, [](auto x, auto y, auto z) {
+ProceduralSourcePtr makeHyperboloidSource(size_t dim_size, double cutoff) {
+    return makeImplicitSurfaceSource(dim_size, cutoff, [](auto x, auto y, auto z) {
         return 2.0*x*x + 2.0*y*y - 2.0*z*z - 1.0;
     });
 }
 
-Frame3D<GLfloat> makeHyperbolicParaboloidFrame(size_t dim_size, double cutoff) {
-    return makeImplicitSurfaceFrame(dim_size, cutoff, [](auto x, auto y, auto z) {
+ProceduralSourcePtr makeHyperbolicParaboloidSource(size_t dim_size, double cutoff) {
+    return makeImplicitSurfaceSource(dim_size, cutoff, [](auto x, auto y, auto z) {
         return x*x - y*y - z;
     });
 }
 
-Frame3D<GLfloat> makeHelixFrame(size_t dim_size, double cutoff, double R, double r, double a) {
-    return makeImplicitSurfaceFrame(dim_size, cutoff, [R, r, a](auto x, auto y, auto z) {
+ProceduralSourcePtr makeHelixSource(size_t dim_size, double cutoff, double R, double r, double a) {
+    return makeImplicitSurfaceSource(dim_size, cutoff, [R, r, a](auto x, auto y, auto z) {
         const auto xr = x - R * std::cos(z*a);
         const auto yr = y - R * std::sin(z*a);
         return xr*xr + yr*yr - r*r;
     });
 }
 
-Frame3D<GLfloat> makeHelicoidFrame(size_t dim_size, double cutoff) {
-    return makeImplicitSurfaceFrame(dim_size, cutoff, [](auto x, auto y, auto z) {
+ProceduralSourcePtr makeHelicoidSource(size_t dim_size, double cutoff) {
+    return makeImplicitSurfaceSource(dim_size, cutoff, [](auto x, auto y, auto z) {
         return x*std::sin(z*4.0) - y*std::cos(z*4.0);
     });
 }
 
-Frame3D<GLfloat> makeTorusFrame(size_t dim_size, double cutoff, double R, double r) {
-    return makeImplicitSurfaceFrame(dim_size, cutoff, [R, r](auto x, auto y, auto z) {
-        const auto tmp = (x*x + y*y + z*z + R*R - r*r);
-        return tmp*tmp - 4*R*R*(x*x + y*y);
-    });
+ProceduralSourcePtr makeTorusSource(size_t dim_size, double cutoff, double R, double r) {
+    return makeImplicitSurfaceSource(dim_size, cutoff, torusFunction(R, r));
 }
 
-Frame3D<GLfloat> makeBubblesFrame(size_t dim_size, size_t num_of_bubbles, double min_rad, double max_rad) {
-    //std::random_device rd;
-    std::mt19937 mt(static_cast<unsigned int>(time(nullptr)));
-    std::uniform_real_distribution<double> rad_distribution(min_rad, max_rad);
-    std::uniform_real_distribution<double> pos_distribution(0.0f + max_rad, 1.0f - max_rad);
+ProceduralSourcePtr makeBubblesSource(size_t dim_size, size_t num_of_bubbles, double min_rad, double max_rad, std::uint64_t seed) {
+    const Philox4x32 rng(seed);
+    const auto pos_min = max_rad;
+    const auto pos_max = 1.0 - max_rad;
 
     std::vector<std::pair<QVector3D, double>> bubbles;
     for (size_t i = 0; i < num_of_bubbles; i++) {
-        const auto pos = QVector3D(pos_distribution(mt), pos_distribution(mt), pos_distribution(mt));
-        const auto radius = rad_distribution(mt);
+        const auto r = rng(i, RS_BUBBLES);
+        const auto pos = QVector3D(lerp(Philox4x32::toUniform(r[0]), pos_min, pos_max),
+                                   lerp(Philox4x32::toUniform(r[1]), pos_min, pos_max),
+                                   lerp(Philox4x32::toUniform(r[2]), pos_min, pos_max));
+        const auto radius = lerp(Philox4x32::toUniform(r[3]), min_rad, max_rad);
         bubbles.push_back(std::make_pair(pos, radius));
     }
 
-    Frame3D<GLfloat> frame(dim_size, dim_size, dim_size);
     const auto coeff = 1.0 / (dim_size - 1);
-    frame.fill([&](size_t i, size_t j, size_t k) -> auto {
+    return makeSource(dim_size, [coeff, bubbles](size_t i, size_t j, size_t k) -> double {
         const auto x = double(i) * coeff;
         const auto y = double(j) * coeff;
         const auto z = double(k) * coeff;
@@ -248,35 +271,21 @@ Frame3D<GLfloat> makeBubblesFrame(size_t dim_size, size_t num_of_bubbles, double
         }
         return std::min(value, 1.0);
     });
-    return frame;
 }
 
-Frame3D<GLfloat> makePerlinNoiseFrame(size_t dim_size, double freq) {
-    std::vector<size_t> permutations;
-    for (size_t i = 0; i < 256; i++) {
-        permutations.push_back(i);
-    }
-    std::random_shuffle(permutations.begin(), permutations.end());
-
-    Frame3D<GLfloat> frame(dim_size, dim_size, dim_size);
-    frame.fill([&](size_t i, size_t j, size_t k) -> auto {
+ProceduralSourcePtr makePerlinNoiseSource(size_t dim_size, double freq, std::uint64_t seed) {
+    const auto permutations = randomPermutations(256, seed);
+    return makeSource(dim_size, [freq, permutations](size_t i, size_t j, size_t k) -> double {
         const auto x = double(i) * freq;
         const auto y = double(j) * freq;
         const auto z = double(k) * freq;
         return noise(x, y, z, permutations);
     });
-    return frame;
 }
 
-Frame3D<GLfloat> makePerlinNoiseOctavesFrame(size_t dim_size, int steps, double start_freq, double start_ampl) {
-    std::vector<size_t> permutations;
-    for (size_t i = 0; i < 256; i++) {
-        permutations.push_back(i);
-    }
-    std::random_shuffle(permutations.begin(), permutations.end());
-
-    Frame3D<GLfloat> frame(dim_size, dim_size, dim_size);
-    frame.fill([&](size_t i, size_t j, size_t k) -> auto {
+ProceduralSourcePtr makePerlinNoiseOctavesSource(size_t dim_size, int steps, double start_freq, double start_ampl, std::uint64_t seed) {
+    const auto permutations = randomPermutations(256, seed);
+    return makeSource(dim_size, [steps, start_freq, start_ampl, permutations](size_t i, size_t j, size_t k) -> double {
         double value = 0.0;
         const auto x = double(i) * start_freq;
         const auto y = double(j) * start_freq;
@@ -287,5 +296,164 @@ Frame3D<GLfloat> makePerlinNoiseOctavesFrame(size_t dim_size, int steps, double
         }
         return std::min(1.0, value);
     });
-    return frame;
+}
+
+Frame3D<GLfloat> makeRandomFrame(size_t dim_size, std::uint64_t seed) {
+    return makeRandomSource(dim_size, seed)->materialize();
+}
+
+Frame3D<GLfloat> makeSectorFrame(size_t dim_size) {
+    return makeSectorSource(dim_size)->materialize();
+}
+
+Frame3D<GLfloat> makeSphereFrame(size_t dim_size) {
+    return makeSphereSource(dim_size)->materialize();
+}
+
+Frame3D<GLfloat> makeAnalyticalSurfaceFrame(size_t dim_size, double cutoff,
+                                            std::function<double (double, double)> surface_func) {
+    return makeAnalyticalSurfaceSource(dim_size, cutoff, surface_func)->materialize();
+}
+
+Frame3D<GLfloat> makeImplicitSurfaceFrame(size_t dim_size, double cutoff,
+                                           std::function<double (double, double, double)> surface_func) {
+    return makeImplicitSurfaceSource(dim_size, cutoff, surface_func)->materialize();
+}
+
+Frame3D<GLfloat> makeImplicitShellFrame(size_t dim_size, double thickness,
+                                        std::function<double (double, double, double)> surface_func) {
+    // Only the sign of the function is sampled; distance to its zero level is computed exactly.
+    const auto coeff = 2.0/(dim_size - 1);
+    Mask3D inside(dim_size, dim_size, dim_size);
+    inside.fill([&](size_t i, size_t j, size_t k) -> auto {
+        return surface_func(1.0 - double(i) * coeff, 1.0 - double(j) * coeff, 1.0 - double(k) * coeff) < 0.0 ? 1 : 0;
+    });
+    return makeShellFrame(signedDistanceField(inside), thickness / coeff);
+}
+
+Frame3D<GLfloat> makeParaboloidFrame(size_t dim_size, double cutoff) {
+    return makeParaboloidSource(dim_size, cutoff)->materialize();
+}
+
+Frame3D<GLfloat> makeHyperboloidFrame(size_t dim_size, double cutoff) {
+    return makeHyperboloidSource(dim_size, cutoff)->materialize();
+}
+
+Frame3D<GLfloat> makeHyperbolicParaboloidFrame(size_t dim_size, double cutoff) {
+    return makeHyperbolicParaboloidSource(dim_size, cutoff)->materialize();
+}
+
+Frame3D<GLfloat> makeHelixFrame(size_t dim_size, double cutoff, double R, double r, double a) {
+    return makeHelixSource(dim_size, cutoff, R, r, a)->materialize();
+}
+
+Frame3D<GLfloat> makeHelicoidFrame(size_t dim_size, double cutoff) {
+    return makeHelicoidSource(dim_size, cutoff)->materialize();
+}
+
+Frame3D<GLfloat> makeTorusFrame(size_t dim_size, double cutoff, double R, double r) {
+    return makeTorusSource(dim_size, cutoff, R, r)->materialize();
+}
+
+Frame3D<GLfloat> makeTorusShellFrame(size_t dim_size, double thickness, double R, double r) {
+    return makeImplicitShellFrame(dim_size, thickness, torusFunction(R, r));
+}
+
+Frame3D<GLfloat> makeBubblesFrame(size_t dim_size, size_t num_of_bubbles, double min_rad, double max_rad, std::uint64_t seed) {
+    return makeBubblesSource(dim_size, num_of_bubbles, min_rad, max_rad, seed)->materialize();
+}
+
+Frame3D<GLfloat> makePerlinNoiseFrame(size_t dim_size, double freq, std::uint64_t seed) {
+    return makePerlinNoiseSource(dim_size, freq, seed)->materialize();
+}
+
+Frame3D<GLfloat> makePerlinNoiseOctavesFrame(size_t dim_size, int steps, double start_freq, double start_ampl, std::uint64_t seed) {
+    return makePerlinNoiseOctavesSource(dim_size, steps, start_freq, start_ampl, seed)->materialize();
+}
+
+GLfloat sampleTrilinear(const Frame3D<GLfloat> &frame, float x, float y, float z) {
+    const float coords[3] = {x, y, z};
+    const size_t sizes[3] = {frame.width(), frame.height(), frame.depth()};
+    size_t i0[3], i1[3];
+    float t[3];
+    for (int k = 0; k < 3; k++) {
+        const auto n = static_cast<float>(sizes[k]);
+        const auto u = std::min(std::max(coords[k] * n - 0.5f, 0.0f), n - 1.0f);
+        i0[k] = static_cast<size_t>(u);
+        i1[k] = std::min(i0[k] + 1, sizes[k] - 1);
+        t[k] = u - static_cast<float>(i0[k]);
+    }
+    const auto lerp = [](GLfloat a, GLfloat b, float s) {
+        return a + (b - a) * s;
+    };
+    const auto c00 = lerp(frame.at(i0[0], i0[1], i0[2]), frame.at(i1[0], i0[1], i0[2]), t[0]);
+    const auto c10 = lerp(frame.at(i0[0], i1[1], i0[2]), frame.at(i1[0], i1[1], i0[2]), t[0]);
+    const auto c01 = lerp(frame.at(i0[0], i0[1], i1[2]), frame.at(i1[0], i0[1], i1[2]), t[0]);
+    const auto c11 = lerp(frame.at(i0[0], i1[1], i1[2]), frame.at(i1[0], i1[1], i1[2]), t[0]);
+    return lerp(lerp(c00, c10, t[1]), lerp(c01, c11, t[1]), t[2]);
+}
+
+namespace {
+
+// Gathers vectorize only with 32-bit indices, so they're used for frames which fit them.
+template <typename Index>
+void sampleTrilinearPacket(const Frame3D<GLfloat> &frame, const float *x, const float *y, const float *z, GLfloat *values, size_t count) {
+    const auto width = static_cast<Index>(frame.width());
+    const auto height = static_cast<Index>(frame.height());
+    const auto depth = static_cast<Index>(frame.depth());
+    const auto w = static_cast<float>(width), h = static_cast<float>(height), d = static_cast<float>(depth);
+    const Index row = width, slice = width * height;
+    const auto *data = frame.data();
+    #pragma omp simd
+    for (size_t i = 0; i < count; i++) {
+        const auto u = std::min(std::max(x[i] * w - 0.5f, 0.0f), w - 1.0f);
+        const auto v = std::min(std::max(y[i] * h - 0.5f, 0.0f), h - 1.0f);
+        const auto s = std::min(std::max(z[i] * d - 0.5f, 0.0f), d - 1.0f);
+        const auto x0 = static_cast<Index>(u), y0 = static_cast<Index>(v), z0 = static_cast<Index>(s);
+        // Offsets to the next voxel along each axis, zero at the last one.
+        const Index dx = (x0 + 1 < width ? 1 : 0), dy = (y0 + 1 < height ? row : 0), dz = (z0 + 1 < depth ? slice : 0);
+        const auto tx = u - static_cast<float>(x0), ty = v - static_cast<float>(y0), tz = s - static_cast<float>(z0);
+        const Index base = z0 * slice + y0 * row + x0;
+        const auto c00 = data[base] + (data[base + dx] - data[base]) * tx;
+        const auto c10 = data[base + dy] + (data[base + dy + dx] - data[base + dy]) * tx;
+        const auto c01 = data[base + dz] + (data[base + dz + dx] - data[base + dz]) * tx;
+        const auto c11 = data[base + dz + dy] + (data[base + dz + dy + dx] - data[base + dz + dy]) * tx;
+        const auto c0 = c00 + (c10 - c00) * ty;
+        const auto c1 = c01 + (c11 - c01) * ty;
+        values[i] = c0 + (c1 - c0) * tz;
+    }
+}
+
+}
+
+void sampleTrilinear(const Frame3D<GLfloat> &frame, const float *x, const float *y, const float *z, GLfloat *values, size_t count) {
+    if (frame.size() <= static_cast<size_t>(std::numeric_limits<std::int32_t>::max())) {
+        sampleTrilinearPacket<std::int32_t>(frame, x, y, z, values, count);
+    } else {
+        sampleTrilinearPacket<std::ptrdiff_t>(frame, x, y, z, values, count);
+    }
+}
+
+std::vector<GLfloat> packChannels(const std::vector<std::shared_ptr<const Frame3D<GLfloat>>> &frames) {
+    if (frames.empty()) {
+        return {};
+    }
+    const auto &first = *frames.front();
+    const auto width = first.width(), height = first.height(), depth = first.depth();
+    std::vector<GLfloat> packed(first.size() * 4, 0.0f);
+    for (size_t c = 0; c < std::min(frames.size(), size_t(4)); c++) {
+        const auto &frame = *frames[c];
+        const auto same_size = (frame.width() == width && frame.height() == height && frame.depth() == depth);
+        #pragma omp parallel for
+        for (int z = 0; z < static_cast<int>(depth); z++) {
+            const auto zi = static_cast<size_t>(z);
+            for (size_t y = 0; y < height; y++) {
+                for (size_t x = 0; x < width; x++) {
+                    packed[first.index(x, y, zi) * 4 + c] = (same_size ? frame.at(x, y, zi) :
+                        sampleTrilinear(frame, (x + 0.5f) / width, (y + 0.5f) / height, (zi + 0.5f) / depth));
+                }
+            }
+        }
+    }
+    return packed;
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "frame3d.h"
+#include "volume_source.h"
 
 #include <QOpenGLFunctions>
 #include <QVector3D>
@@ -8,8 +9,36 @@
 #include <vector>
 #include <string>
 #include <functional>
+#include <cstdint>
+#include <memory>
 
-Frame3D<GLfloat> makeRandomFrame(size_t dim_size);
+using ProceduralSourcePtr = std::shared_ptr<ProceduralVolumeSource>;
+
+// Generators of volumes that are evaluated lazily (by bricks) on demand.
+ProceduralSourcePtr makeRandomSource(size_t dim_size, std::uint64_t seed = 0);
+ProceduralSourcePtr makeSectorSource(size_t dim_size);
+ProceduralSourcePtr makeSphereSource(size_t dim_size);
+
+ProceduralSourcePtr makeAnalyticalSurfaceSource(size_t dim_size, double cutoff,
+                                                std::function<double(double,double)> surface_func);
+ProceduralSourcePtr makeImplicitSurfaceSource(size_t dim_size, double cutoff,
+                                              std::function<double(double,double,double)> surface_func);
+
+ProceduralSourcePtr makeParaboloidSource(size_t dim_size, double cutoff);
+ProceduralSourcePtr makeHyperboloidSource(size_t dim_size, double cutoff);
+ProceduralSourcePtr makeHyperbolicParaboloidSource(size_t dim_size, double cutoff);
+ProceduralSourcePtr makeHelixSource(size_t dim_size, double cutoff, double R, double r, double a);
+ProceduralSourcePtr makeHelicoidSource(size_t dim_size, double cutoff);
+ProceduralSourcePtr makeTorusSource(size_t dim_size, double cutoff, double R, double r);
+
+ProceduralSourcePtr makeBubblesSource(size_t dim_size, size_t num_of_bubbles, double min_rad, double max_rad, std::uint64_t seed = 0);
+
+ProceduralSourcePtr makePerlinNoiseSource(size_t dim_size, double freq = 1.0, std::uint64_t seed = 0);
+ProceduralSourcePtr makePerlinNoiseOctavesSource(size_t dim_size, int steps, double start_freq = 1.0, double start_ampl = 1.0,
+                                                 std::uint64_t seed = 0);
+
+// Generators that evaluate the whole volume at once.
+Frame3D<GLfloat> makeRandomFrame(size_t dim_size, std::uint64_t seed = 0);
 Frame3D<GLfloat> makeSectorFrame(size_t dim_size);
 Frame3D<GLfloat> makeSphereFrame(size_t dim_size);
 
@@ -17,6 +46,9 @@ Frame3D<GLfloat> makeAnalyticalSurfaceFrame(size_t dim_size, double cutoff,
                                             std::function<double(double,double)> surface_func);
 Frame3D<GLfloat> makeImplicitSurfaceFrame(size_t dim_size, double cutoff,
                                            std::function<double(double,double,double)> surface_func);
+// Shell of fixed thickness (in [-1, 1] cube units) around the zero level of the function, built from exact distances.
+Frame3D<GLfloat> makeImplicitShellFrame(size_t dim_size, double thickness,
+                                        std::function<double(double,double,double)> surface_func);
 
 Frame3D<GLfloat> makeParaboloidFrame(size_t dim_size, double cutoff);
 Frame3D<GLfloat> makeHyperboloidFrame(size_t dim_size, double cutoff);
@@ -24,8 +56,22 @@ Frame3D<GLfloat> makeHyperbolicParaboloidFrame(size_t dim_size, double cutoff);
 Frame3D<GLfloat> makeHelixFrame(size_t dim_size, double cutoff, double R, double r, double a);
 Frame3D<GLfloat> makeHelicoidFrame(size_t dim_size, double cutoff);
 Frame3D<GLfloat> makeTorusFrame(size_t dim_size, double cutoff, double R, double r);
+Frame3D<GLfloat> makeTorusShellFrame(size_t dim_size, double thickness, double R, double r);
+
+Frame3D<GLfloat> makeBubblesFrame(size_t dim_size, size_t num_of_bubbles, double min_rad, double max_rad, std::uint64_t seed = 0);
+
+Frame3D<GLfloat> makePerlinNoiseFrame(size_t dim_size, double freq = 1.0, std::uint64_t seed = 0);
+Frame3D<GLfloat> makePerlinNoiseOctavesFrame(size_t dim_size, int steps, double start_freq = 1.0, double start_ampl = 1.0,
+                                             std::uint64_t seed = 0);
+
+// Value at a position in texture coordinates ([0, 1] over the whole frame), like sampling of a 3D texture
+// with linear filtering and clamping to edge (voxels are centered at (i + 0.5)/n).
+GLfloat sampleTrilinear(const Frame3D<GLfloat> &frame, float x, float y, float z);
 
-Frame3D<GLfloat> makeBubblesFrame(size_t dim_size, size_t num_of_bubbles, double min_rad, double max_rad);
+// Values at count positions, like sampleTrilinear for each of them; the loop over positions is vectorized,
+// so neighbouring rays can sample together.
+void sampleTrilinear(const Frame3D<GLfloat> &frame, const float *x, const float *y, const float *z, GLfloat *values, size_t count);
 
-Frame3D<GLfloat> makePerlinNoiseFrame(size_t dim_size, double freq = 1.0);
-Frame3D<GLfloat> makePerlinNoiseOctavesFrame(size_t dim_size, int steps, double start_freq = 1.0, double start_ampl = 1.0);
+// Co-registered frames interleaved into RGBA voxels (up to four, missing components are zero) of the size of the first one;
+// frames of other sizes are resampled.
+std::vector<GLfloat> packChannels(const std::vector<std::shared_ptr<const Frame3D<GLfloat>>> &frames);
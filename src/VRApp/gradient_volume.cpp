@@ -0,0 +1,79 @@
+#include "gradient_volume.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Largest central difference magnitude for values in [0, 1].
+const float MAX_MAGNITUDE = 0.5f * std::sqrt(3.0f);
+
+// Value in [-1, 1] mapped to the nearest of [0, 255].
+GLuint packComponent(float value) {
+    return static_cast<GLuint>(std::min(std::max(value * 127.5f + 127.5f, 0.0f), 255.0f) + 0.5f);
+}
+
+GLuint packGradient(float gx, float gy, float gz, float magnitude) {
+    const auto length = std::sqrt(gx*gx + gy*gy + gz*gz);
+    const auto scale = (length > 0.0f ? 1.0f / length : 0.0f);
+    // Square root of the magnitude is stored, to keep precision for small gradients.
+    const auto m = std::sqrt(std::min(magnitude / MAX_MAGNITUDE, 1.0f));
+    return packComponent(gx * scale) |
+           (packComponent(gy * scale) << 8) |
+           (packComponent(gz * scale) << 16) |
+           (static_cast<GLuint>(m * 255.0f + 0.5f) << 24);
+}
+
+void computeSlices(const Frame3D<GLfloat> &frame, GradientFrame &gradient, size_t z_begin, size_t z_end) {
+    const auto w = frame.width(), h = frame.height(), d = frame.depth();
+    const auto *data = frame.data();
+    auto *result = gradient.data();
+    const auto scale_x = static_cast<float>(w), scale_y = static_cast<float>(h), scale_z = static_cast<float>(d);
+    const auto begin = static_cast<long long>(z_begin), end = static_cast<long long>(z_end);
+    #pragma omp parallel for collapse(2)
+    for (long long k = begin; k < end; k++) {
+        for (long long j = 0; j < static_cast<long long>(h); j++) {
+            const auto z = static_cast<size_t>(k), y = static_cast<size_t>(j);
+            const auto z0 = (z > 0 ? z - 1 : z), z1 = std::min(z + 1, d - 1);
+            const auto y0 = (y > 0 ? y - 1 : y), y1 = std::min(y + 1, h - 1);
+            // Differences are divided by the actual distance, which is less at borders.
+            const auto inv_dz = (z1 > z0 ? 1.0f / static_cast<float>(z1 - z0) : 0.0f);
+            const auto inv_dy = (y1 > y0 ? 1.0f / static_cast<float>(y1 - y0) : 0.0f);
+            const auto *row = data + (z*h + y)*w;
+            const auto *row_y0 = data + (z*h + y0)*w, *row_y1 = data + (z*h + y1)*w;
+            const auto *row_z0 = data + (z0*h + y)*w, *row_z1 = data + (z1*h + y)*w;
+            auto *out = result + (z*h + y)*w;
+            auto pack = [&](size_t x, float gx) {
+                const auto gy = (row_y1[x] - row_y0[x]) * inv_dy;
+                const auto gz = (row_z1[x] - row_z0[x]) * inv_dz;
+                out[x] = packGradient(gx * scale_x, gy * scale_y, gz * scale_z, std::sqrt(gx*gx + gy*gy + gz*gz));
+            };
+            if (w == 1) {
+                pack(0, 0.0f);
+                continue;
+            }
+            pack(0, row[1] - row[0]);
+            for (size_t x = 1; x + 1 < w; x++) {
+                pack(x, (row[x + 1] - row[x - 1]) * 0.5f);
+            }
+            pack(w - 1, row[w - 1] - row[w - 2]);
+        }
+    }
+}
+
+}
+
+GradientFrame computeGradient(const Frame3D<GLfloat> &frame) {
+    GradientFrame gradient(frame.width(), frame.height(), frame.depth());
+    computeSlices(frame, gradient, 0, frame.depth());
+    return gradient;
+}
+
+void updateGradient(const Frame3D<GLfloat> &frame, GradientFrame &gradient, size_t z_begin, size_t z_end) {
+    // Central differences of the neighbouring slices depend on the changed ones too.
+    z_begin = (z_begin > 0 ? z_begin - 1 : 0);
+    z_end = std::min(z_end + 1, frame.depth());
+    if (z_begin < z_end) {
+        computeSlices(frame, gradient, z_begin, z_end);
+    }
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "frame3d.h"
+
+#include <QOpenGLFunctions>
+
+/*
+ * Precomputed gradients of 3D frames for lighting, one texel per voxel.
+ * Each voxel is packed into 32 bits to be uploaded as RGBA8 (UInt32_RGBA8_Rev, red in the lowest byte):
+ * RGB is the unit normal mapped from [-1, 1] to [0, 255], A is the square root of the gradient magnitude.
+ * Uniform regions have no normal: their A is zero (RGB is just the middle of the range), and shaders don't light them.
+ * Unlike octahedral encoding, this packing survives trilinear filtering (filtered normal is just renormalized).
+ */
+
+using GradientFrame = Frame3D<GLuint>;
+
+// Central differences (one-sided at borders) at voxel resolution.
+// Normal is taken in texture coordinates (differences are scaled by the frame dimensions), as in the shaders;
+// magnitude is in value units per voxel, scaled so that 255 is the largest possible one for values in [0, 1].
+GradientFrame computeGradient(const Frame3D<GLfloat> &frame);
+
+// Recompute the gradient only for slices affected by a change of frame slices [z_begin, z_end).
+void updateGradient(const Frame3D<GLfloat> &frame, GradientFrame &gradient, size_t z_begin, size_t z_end);
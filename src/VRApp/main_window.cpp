@@ -8,6 +8,8 @@
 #include "cube/cube_util.h"
 #include "render/slice_renderer.h"
 #include "render/ray_cast_renderer.h"
+#include "render/cpu_ray_cast_renderer.h"
+#include "render/brick_atlas.h"
 
 #include <QStatusBar>
 #include <QToolBar>
@@ -17,23 +19,15 @@
 #include <QSettings>
 #include <QSlider>
 #include <QLineEdit>
+#include <QInputDialog>
+#include <QStandardPaths>
+#include <QtConcurrent>
 
 #include <cmath>
+#include <limits>
 
 namespace {
 
-std::vector<GLfloat> defaultOpacityPalette() {
-    return {0.0f, 0.001f, 0.002f, 0.003f, 0.01f, 0.02f, 0.05f, 1.0f};
-}
-
-std::vector<GLfloat> powOpacityPalette(int n) {
-    return makeOpacityPalette(1024, [n](const GLfloat &x) {return std::pow(x, n);});
-}
-
-std::vector<GLfloat> logOpacityPalette(float step = 1.0f) {
-    return makeOpacityPalette(1024, [step](const GLfloat &x) {return std::log(x + step) / std::log(1.0f + step);});
-}
-
 QColor getColorSetting(QString key, QColor default_color) {
     QSettings settings;
     auto value = settings.value(key, static_cast<unsigned int>(default_color.rgb()));
@@ -65,10 +59,25 @@ const static QString SHOW_TOOLBAR_KEY = "show-toolbar";
 const static QString SHOW_STATUSBAR_KEY = "show-statusbar";
 const static QString ENABLE_LIGHTING_KEY = "enable-lighting";
 const static QString ENABLE_JITTER_KEY = "enable-jitter";
+const static QString ENABLE_PREINTEGRATION_KEY = "enable-preintegration";
 const static QString ENABLE_CORRECT_SCALE_KEY = "enable-correct-scale";
+const static QString KEEP_THIN_FEATURES_KEY = "keep-thin-features";
 const static QString CUTOFF_LOW_KEY = "cutoff-low";
 const static QString CUTOFF_HIGH_KEY = "cutoff-high";
 const static QString STEP_MULTIPLIER_KEY = "step-multiplier";
+const static QString RANDOM_SEED_KEY = "random-seed";
+const static QString FRAME_CACHE_BUDGET_KEY = "frame-cache-budget-mb";
+const static QString ENABLE_DISK_CACHE_KEY = "enable-disk-cache";
+const static QString HOST_BUDGET_KEY = "host-budget-mb";
+const static QString GPU_BUDGET_KEY = "gpu-budget-mb";
+const static int DEFAULT_HOST_BUDGET = 4096;
+const static int DEFAULT_GPU_BUDGET = 1024;
+const static QString ENABLE_PROGRESSIVE_LOADING_KEY = "enable-progressive-loading";
+const static QString ENABLE_VIRTUAL_TEXTURING_KEY = "enable-virtual-texturing";
+const static QString ATLAS_SIZE_KEY = "atlas-size";
+const static QString SHOW_TIMINGS_KEY = "show-timings";
+const static QString TIMINGS_DIR_KEY = "timings-dir";
+const static size_t PREVIEW_SIZE = 64; // max size of the preview of a progressively loaded frame along any axis
 
 }
 
@@ -80,6 +89,7 @@ MainWindow::MainWindow(QWidget *parent) :
 
     gl_widget = ui->openGLWidget;
     connect(gl_widget, &MyOpenGLWidget::initialized, this, &MainWindow::initGlWidget);
+    connect(&load_watcher, &QFutureWatcher<LoadedFrame>::finished, this, &MainWindow::onLoadStepFinished);
 
     initMenu();
     initStatusbar();
@@ -98,7 +108,13 @@ void MainWindow::initMenu() {
     connect(this, &MainWindow::showStatusbarChanged, ui->actionShow_hide_Statusbar, &QAction::setChecked);
     connect(this, &MainWindow::enableLightingChanged, ui->actionUse_Lighting, &QAction::setChecked);
     connect(this, &MainWindow::enableJitterChanged, ui->actionEnable_Jitter, &QAction::setChecked);
+    connect(this, &MainWindow::enablePreintegrationChanged, ui->actionEnable_Preintegration, &QAction::setChecked);
     connect(this, &MainWindow::enableCorrectScaleChanged, ui->actionCorrect_Scale, &QAction::setChecked);
+    connect(this, &MainWindow::keepThinFeaturesChanged, ui->actionKeep_Thin_Features, &QAction::setChecked);
+    connect(this, &MainWindow::enableDiskCacheChanged, ui->actionCache_Frames_on_Disk, &QAction::setChecked);
+    connect(this, &MainWindow::enableProgressiveLoadingChanged, ui->actionProgressive_Loading, &QAction::setChecked);
+    connect(this, &MainWindow::enableVirtualTexturingChanged, ui->actionVirtual_Texturing, &QAction::setChecked);
+    connect(this, &MainWindow::showTimingsChanged, ui->actionShow_Frame_Timings, &QAction::setChecked);
 }
 
 void MainWindow::initStatusbar() {
@@ -109,8 +125,25 @@ void MainWindow::initStatusbar() {
        cutoff_label->setText(QString("Cutoff: [%0, %1]").arg(low).arg(high));
     });
 
+    upload_label = new QLabel(this);
+    upload_label->hide();
+    connect(gl_widget, &MyOpenGLWidget::uploadProgress, [this](int percent) {
+        upload_label->setText(QString("Uploading: %0%").arg(percent));
+        upload_label->setVisible(percent < 100);
+    });
+
+    timing_label = new QLabel(this);
+    timing_label->hide();
+    // Stats are rolling, so it's enough to refresh them a couple of times per second.
+    timing_timer.setInterval(500);
+    connect(&timing_timer, &QTimer::timeout, [this]() {
+        timing_label->setText(gl_widget->getProfiler().summary());
+    });
+
     ui->statusBar->addWidget(size_label);
     ui->statusBar->addWidget(cutoff_label);
+    ui->statusBar->addWidget(upload_label);
+    ui->statusBar->addWidget(timing_label);
 }
 
 void MainWindow::initToolbar() {
@@ -163,9 +196,9 @@ void MainWindow::initGlWidget() {
         gl_widget->setBackgroundColor(bgColor);
     }
 
-    setFrame(makeSectorFrame(gl_widget->getFrameSize()), "Sector");
+    setGeneratedFrame("Sector", {}, 0, [](size_t size) {return makeSectorFrame(size);});
     setColorPalette(makeRainbowWithBlackPalette());
-    setOpacityPalette(powOpacityPalette(1));
+    setOpacityPalette(makePowOpacityPalette(1));
     setRenderer(std::make_shared<RayCastRenderer>());
 
     initSettings();
@@ -174,32 +207,153 @@ void MainWindow::initGlWidget() {
 void MainWindow::initSettings() {
     setCutoff(getSetting(CUTOFF_LOW_KEY, 0.0).toFloat(), getSetting(CUTOFF_HIGH_KEY, 1.0).toFloat());
     setStepMultiplier(getSetting(STEP_MULTIPLIER_KEY, 1).toInt());
+    setRandomSeed(getSetting(RANDOM_SEED_KEY, 0).toInt());
+    frame_cache.setByteBudget(static_cast<size_t>(getSetting(FRAME_CACHE_BUDGET_KEY, 512).toInt()) * 1024 * 1024);
+    enableDiskCache(getSetting(ENABLE_DISK_CACHE_KEY, false).toBool());
+    enableProgressiveLoading(getSetting(ENABLE_PROGRESSIVE_LOADING_KEY, false).toBool());
+    setAtlasSize(getSetting(ATLAS_SIZE_KEY, 0).toInt());
+    enableVirtualTexturing(getSetting(ENABLE_VIRTUAL_TEXTURING_KEY, false).toBool());
 
     enableLighting(getSetting(ENABLE_LIGHTING_KEY, false).toBool());
     enableJitter(getSetting(ENABLE_JITTER_KEY, false).toBool());
+    enablePreintegration(getSetting(ENABLE_PREINTEGRATION_KEY, false).toBool());
     enableCorrectScale(getSetting(ENABLE_CORRECT_SCALE_KEY, false).toBool());
+    keepThinFeatures(getSetting(KEEP_THIN_FEATURES_KEY, false).toBool());
 
     showToolbar(getSetting(SHOW_TOOLBAR_KEY, false).toBool());
     showStatusbar(getSetting(SHOW_STATUSBAR_KEY, false).toBool());
+    showTimings(getSetting(SHOW_TIMINGS_KEY, false).toBool());
 }
 
 void MainWindow::resetSettings() {
+    setActiveChannel(0);
     setCutoff(0.0, 1.0);
     setStepMultiplier(1);
+    setRandomSeed(0);
+    enableDiskCache(false);
+    enableProgressiveLoading(false);
+    setAtlasSize(0);
+    enableVirtualTexturing(false);
     enableLighting(false);
     enableJitter(false);
+    enablePreintegration(false);
     enableCorrectScale(false);
+    keepThinFeatures(false);
     showToolbar(true);
     showStatusbar(true);
+    showTimings(false);
+}
+
+void MainWindow::setFrame(std::shared_ptr<const Frame3D<GLfloat>> frame, const QString &title, const LoadInfo &info) {
+    cancelLoading();
+    showFrame(prepareFrame(frame, gl_widget->frameOptions(), gl_widget->preparedFrame()), title, info);
 }
 
-void MainWindow::setFrame(const Frame3D<GLfloat> &frame, const QString &title) {
+void MainWindow::showFrame(const PreparedFrame &frame, const QString &title, const LoadInfo &info) {
     setWindowTitle(default_title + (!title.isEmpty() ? ": " + title : ""));
-    size_label->setText(QString("Size: %0 x %1 x %2").arg(frame.width()).arg(frame.height()).arg(frame.depth()));
-    gl_widget->setFrame(frame);
+    const auto &data = *frame.frame;
+    auto size_text = QString("Size: %0 x %1 x %2").arg(data.width()).arg(data.height()).arg(data.depth());
+    QVector3D extent;
+    if (info.factor > 1) {
+        size_text += QString(" (decimated %0x from %1 x %2 x %3)").arg(info.factor).arg(info.width).arg(info.height).arg(info.depth);
+        extent = QVector3D(info.width, info.height, info.depth);
+    }
+    size_label->setText(size_text);
+    gl_widget->setFrame(frame, extent);
     gl_widget->update();
 }
 
+void MainWindow::loadFrame(const QString &title, FrameLoadFunc func) {
+    const auto policy = getLoadPolicy();
+    if (!progressive_loading) {
+        LoadInfo info;
+        setFrame(std::make_shared<const Frame3D<GLfloat>>(func(policy, &info)), title, info);
+        return;
+    }
+
+    // Preview is sampled from a few rows of the file, so it's shown quickly whatever the file size is.
+    auto preview_policy = policy;
+    preview_policy.host_budget = static_cast<size_t>(PREVIEW_SIZE * PREVIEW_SIZE * PREVIEW_SIZE *
+                                                     policy.host_bytes_per_voxel);
+    preview_policy.strided = true;
+    LoadInfo info;
+    setFrame(std::make_shared<const Frame3D<GLfloat>>(func(preview_policy, &info)), title, info);
+    if (info.factor <= 1) {
+        return; // the whole data is already loaded
+    }
+
+    // Then finer sampled levels, each with half the stride, are swapped in,
+    // and at last the data averaged down to the memory budgets.
+    const auto factor = FrameLoader::decimationFactor(info.width, info.height, info.depth, policy);
+    for (auto stride = info.factor / 2; stride > 2 * factor; stride /= 2) {
+        auto step_policy = policy;
+        step_policy.min_factor = stride;
+        step_policy.strided = true;
+        load_steps.push_back(step_policy);
+    }
+    load_steps.push_back(policy);
+    load_func = func;
+    load_title = title;
+    loadNextStep();
+}
+
+void MainWindow::loadNextStep() {
+    if (load_steps.empty()) {
+        statusBar()->clearMessage();
+        return;
+    }
+    const auto policy = load_steps.front();
+    load_steps.erase(load_steps.begin());
+    const auto func = load_func;
+    const auto options = gl_widget->frameOptions();
+    const auto previous = gl_widget->preparedFrame();
+    statusBar()->showMessage("Refining...");
+    load_watcher.setFuture(QtConcurrent::run([func, policy, options, previous]() {
+        LoadedFrame result;
+        try {
+            // Pyramid, bricks and gradients are computed here too, so the GUI thread only uploads them.
+            auto frame = std::make_shared<const Frame3D<GLfloat>>(func(policy, &result.info));
+            result.frame = prepareFrame(frame, options, previous);
+        }
+        catch (const std::exception &e) {
+            result.error = e.what();
+        }
+        return result;
+    }));
+}
+
+void MainWindow::onLoadStepFinished() {
+    // Watcher is reset to an empty (canceled) future on cancelation.
+    if (load_watcher.isCanceled()) {
+        return;
+    }
+    const auto result = load_watcher.result();
+    if (!result.error.isEmpty()) {
+        cancelLoading();
+        showError(result.error);
+        return;
+    }
+    showFrame(result.frame, load_title, result.info);
+    loadNextStep();
+}
+
+void MainWindow::cancelLoading() {
+    // Running step can't be stopped, but its result is ignored.
+    load_steps.clear();
+    load_func = nullptr;
+    load_watcher.setFuture(QFuture<LoadedFrame>());
+    statusBar()->clearMessage();
+}
+
+void MainWindow::setGeneratedFrame(const QString &title, const std::vector<double> &params, std::uint64_t seed,
+                                   std::function<Frame3D<GLfloat>(size_t)> generator) {
+    // Generated frames are cached, so switching between them does not regenerate the data.
+    const auto size = gl_widget->getFrameSize();
+    const auto key = FrameCache::makeKey(title.toStdString(), params, size, seed);
+    const auto frame = frame_cache.get(key, [&]() {return generator(size);});
+    setFrame(frame, title);
+}
+
 void MainWindow::setColorPalette(const std::vector<QVector3D> &palette) {
     gl_widget->setColorPalette(palette);
     gl_widget->update();
@@ -218,11 +372,21 @@ void MainWindow::setRenderer(std::shared_ptr<Renderer> renderer) {
 void MainWindow::setCutoff(float low, float high) {
     gl_widget->setCutoff(low, high);
     gl_widget->update();
-    setSetting(CUTOFF_LOW_KEY, low);
-    setSetting(CUTOFF_HIGH_KEY, high);
+    // Only the cutoff of the frame is remembered; channels aren't.
+    if (gl_widget->getActiveChannel() == 0) {
+        setSetting(CUTOFF_LOW_KEY, low);
+        setSetting(CUTOFF_HIGH_KEY, high);
+    }
     emit cutoffChanged(low, high);
 }
 
+void MainWindow::setActiveChannel(int channel) {
+    gl_widget->setActiveChannel(channel);
+    // Cutoff controls show the cutoff of the active channel.
+    const auto cutoff = getCutoff();
+    emit cutoffChanged(cutoff.first, cutoff.second);
+}
+
 void MainWindow::enableLighting(bool enabled) {
     gl_widget->enableLighting(enabled);
     gl_widget->update();
@@ -237,6 +401,13 @@ void MainWindow::enableJitter(bool enabled) {
     emit enableJitterChanged(enabled);
 }
 
+void MainWindow::enablePreintegration(bool enabled) {
+    gl_widget->enablePreintegration(enabled);
+    gl_widget->update();
+    setSetting(ENABLE_PREINTEGRATION_KEY, enabled);
+    emit enablePreintegrationChanged(enabled);
+}
+
 void MainWindow::enableCorrectScale(bool enabled) {
     gl_widget->enableCorrectScale(enabled);
     gl_widget->update();
@@ -244,6 +415,13 @@ void MainWindow::enableCorrectScale(bool enabled) {
     emit enableCorrectScaleChanged(enabled);
 }
 
+void MainWindow::keepThinFeatures(bool enabled) {
+    gl_widget->setPyramidFilter(enabled ? PF_MAX : PF_BOX);
+    gl_widget->update();
+    setSetting(KEEP_THIN_FEATURES_KEY, enabled);
+    emit keepThinFeaturesChanged(enabled);
+}
+
 void MainWindow::setStepMultiplier(int multiplier) {
     gl_widget->setStepMultiplier(multiplier);
     gl_widget->update();
@@ -251,6 +429,63 @@ void MainWindow::setStepMultiplier(int multiplier) {
     emit stepMultiplierChanged(multiplier);
 }
 
+LoadPolicy MainWindow::getLoadPolicy() const {
+    LoadPolicy policy;
+    policy.host_budget = static_cast<size_t>(getSetting(HOST_BUDGET_KEY, DEFAULT_HOST_BUDGET).toInt()) * 1024 * 1024;
+    // Budgets cover the pyramid, bricks and gradients of the frame too.
+    policy.host_bytes_per_voxel = gl_widget->hostBytesPerVoxel();
+    policy.gpu_bytes_per_voxel = gl_widget->gpuBytesPerVoxel();
+    // Virtual texture is paged into a brick atlas of a limited size, so only host memory limits the frame.
+    if (!virtual_texturing) {
+        policy.gpu_budget = static_cast<size_t>(getSetting(GPU_BUDGET_KEY, DEFAULT_GPU_BUDGET).toInt()) * 1024 * 1024;
+        policy.max_texture_size = static_cast<size_t>(gl_widget->getMaxTextureSize());
+    }
+    return policy;
+}
+
+void MainWindow::setRandomSeed(int seed) {
+    random_seed = seed;
+    setSetting(RANDOM_SEED_KEY, seed);
+}
+
+void MainWindow::enableDiskCache(bool enabled) {
+    const auto dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/frames";
+    frame_cache.setDiskDir(enabled ? dir.toStdString() : std::string());
+    setSetting(ENABLE_DISK_CACHE_KEY, enabled);
+    emit enableDiskCacheChanged(enabled);
+}
+
+void MainWindow::showTimings(bool show) {
+    timing_label->setVisible(show);
+    if (show) {
+        timing_timer.start();
+    } else {
+        timing_timer.stop();
+    }
+    setSetting(SHOW_TIMINGS_KEY, show);
+    emit showTimingsChanged(show);
+}
+
+void MainWindow::enableProgressiveLoading(bool enabled) {
+    progressive_loading = enabled;
+    setSetting(ENABLE_PROGRESSIVE_LOADING_KEY, enabled);
+    emit enableProgressiveLoadingChanged(enabled);
+}
+
+void MainWindow::enableVirtualTexturing(bool enabled) {
+    virtual_texturing = enabled;
+    gl_widget->enableVirtualTexturing(enabled);
+    setSetting(ENABLE_VIRTUAL_TEXTURING_KEY, enabled);
+    emit enableVirtualTexturingChanged(enabled);
+}
+
+void MainWindow::setAtlasSize(int slots_per_axis) {
+    // Zero means the largest atlas which fits the GPU memory budget.
+    const auto gpu_budget = static_cast<size_t>(getSetting(GPU_BUDGET_KEY, DEFAULT_GPU_BUDGET).toInt()) * 1024 * 1024;
+    gl_widget->setAtlasSize(slots_per_axis > 0 ? static_cast<size_t>(slots_per_axis) : BrickAtlas::slotsForBudget(gpu_budget));
+    setSetting(ATLAS_SIZE_KEY, slots_per_axis);
+}
+
 void MainWindow::showToolbar(bool show) {
     ui->mainToolBar->setHidden(!show);
     setSetting(SHOW_TOOLBAR_KEY, show);
@@ -272,95 +507,109 @@ std::pair<float, float> MainWindow::getCutoff() const {
 }
 
 void MainWindow::on_actionSector_triggered() {
-    setFrame(makeSectorFrame(gl_widget->getFrameSize()), "Sector");
+    setGeneratedFrame("Sector", {}, 0, [](size_t size) {return makeSectorFrame(size);});
 }
 
 void MainWindow::on_actionRandom_triggered() {
-    setFrame(makeRandomFrame(gl_widget->getFrameSize()), "Random");
+    const auto seed = random_seed;
+    setGeneratedFrame("Random", {}, seed, [seed](size_t size) {return makeRandomFrame(size, seed);});
 }
 
 void MainWindow::on_actionSphere_triggered() {
-    setFrame(makeSphereFrame(gl_widget->getFrameSize()), "Sphere");
+    setGeneratedFrame("Sphere", {}, 0, [](size_t size) {return makeSphereFrame(size);});
 }
 
 void MainWindow::on_actionParabololoid_triggered() {
-    setFrame(makeParaboloidFrame(gl_widget->getFrameSize(), 0.2), "Paraboloid");
+    setGeneratedFrame("Paraboloid", {0.2}, 0, [](size_t size) {return makeParaboloidFrame(size, 0.2);});
 }
 
 void MainWindow::on_actionHyperboloid_triggered() {
-    setFrame(makeHyperboloidFrame(gl_widget->getFrameSize(), 0.2), "Hyperboloid");
+    setGeneratedFrame("Hyperboloid", {0.2}, 0, [](size_t size) {return makeHyperboloidFrame(size, 0.2);});
 }
 
 void MainWindow::on_actionHyperbolic_Paraboloid_triggered() {
-    setFrame(makeHyperbolicParaboloidFrame(gl_widget->getFrameSize(), 0.2), "Hyperbolic Paraboloid");
+    setGeneratedFrame("Hyperbolic Paraboloid", {0.2}, 0, [](size_t size) {return makeHyperbolicParaboloidFrame(size, 0.2);});
 }
 
 void MainWindow::on_actionHelix_triggered() {
-    setFrame(makeHelixFrame(gl_widget->getFrameSize(), 0.2, 0.6, 0.1, 8.0), "Helix");
+    setGeneratedFrame("Helix", {0.2, 0.6, 0.1, 8.0}, 0, [](size_t size) {return makeHelixFrame(size, 0.2, 0.6, 0.1, 8.0);});
 }
 
 void MainWindow::on_actionHelicoid_triggered() {
-    setFrame(makeHelicoidFrame(gl_widget->getFrameSize(), 0.2), "Helicoid");
+    setGeneratedFrame("Helicoid", {0.2}, 0, [](size_t size) {return makeHelicoidFrame(size, 0.2);});
 }
 
 void MainWindow::on_actionTorus_triggered() {
-    setFrame(makeTorusFrame(gl_widget->getFrameSize(), 0.2, 0.7, 0.2), "Torus");
+    setGeneratedFrame("Torus", {0.2, 0.7, 0.2}, 0, [](size_t size) {return makeTorusFrame(size, 0.2, 0.7, 0.2);});
+}
+
+void MainWindow::on_actionTorus_Shell_triggered() {
+    setGeneratedFrame("Torus Shell", {0.05, 0.7, 0.2}, 0, [](size_t size) {return makeTorusShellFrame(size, 0.05, 0.7, 0.2);});
 }
 
 void MainWindow::on_actionBubbles_triggered() {
-    setFrame(makeBubblesFrame(gl_widget->getFrameSize(), 20, 0.05, 0.25), "Bubbles");
+    const auto seed = random_seed;
+    setGeneratedFrame("Bubbles", {20, 0.05, 0.25}, seed, [seed](size_t size) {
+        return makeBubblesFrame(size, 20, 0.05, 0.25, seed);
+    });
 }
 
 void MainWindow::on_actionPerlin_Noise_triggered() {
-    setFrame(makePerlinNoiseFrame(gl_widget->getFrameSize(), 0.05));
+    const auto seed = random_seed;
+    setGeneratedFrame("Perlin Noise", {0.05}, seed, [seed](size_t size) {
+        return makePerlinNoiseFrame(size, 0.05, seed);
+    });
 }
 
 void MainWindow::on_actionPerlin_Noise_with_Octaves_triggered() {
-    setFrame(makePerlinNoiseOctavesFrame(gl_widget->getFrameSize(), 4, 0.05, 1.0));
+    const auto seed = random_seed;
+    setGeneratedFrame("Perlin Noise with Octaves", {4, 0.05, 1.0}, seed, [seed](size_t size) {
+        return makePerlinNoiseOctavesFrame(size, 4, 0.05, 1.0, seed);
+    });
 }
 
 void MainWindow::on_actionOpDefault_triggered() {
-    setOpacityPalette(defaultOpacityPalette());
+    setOpacityPalette(makeDefaultOpacityPalette());
 }
 
 void MainWindow::on_actionOp_x_triggered() {
-    setOpacityPalette(powOpacityPalette(1));
+    setOpacityPalette(makePowOpacityPalette(1));
 }
 
 void MainWindow::on_actionOp_x_2_triggered() {
-    setOpacityPalette(powOpacityPalette(2));
+    setOpacityPalette(makePowOpacityPalette(2));
 }
 
 void MainWindow::on_actionOp_x_3_triggered() {
-    setOpacityPalette(powOpacityPalette(3));
+    setOpacityPalette(makePowOpacityPalette(3));
 }
 
 void MainWindow::on_actionOp_x_4_triggered() {
-    setOpacityPalette(powOpacityPalette(4));
+    setOpacityPalette(makePowOpacityPalette(4));
 }
 
 void MainWindow::on_actionOp_x_5_triggered() {
-    setOpacityPalette(powOpacityPalette(5));
+    setOpacityPalette(makePowOpacityPalette(5));
 }
 
 void MainWindow::on_actionOp_x_6_triggered() {
-    setOpacityPalette(powOpacityPalette(6));
+    setOpacityPalette(makePowOpacityPalette(6));
 }
 
 void MainWindow::on_actionOp_x_7_triggered() {
-    setOpacityPalette(powOpacityPalette(7));
+    setOpacityPalette(makePowOpacityPalette(7));
 }
 
 void MainWindow::on_actionOp_x_8_triggered() {
-    setOpacityPalette(powOpacityPalette(8));
+    setOpacityPalette(makePowOpacityPalette(8));
 }
 
 void MainWindow::on_actionOp_x_9_triggered() {
-    setOpacityPalette(powOpacityPalette(9));
+    setOpacityPalette(makePowOpacityPalette(9));
 }
 
 void MainWindow::on_actionOpLog_triggered() {
-    setOpacityPalette(logOpacityPalette());
+    setOpacityPalette(makeLogOpacityPalette());
 }
 
 void MainWindow::on_actionOpFull_triggered() {
@@ -402,9 +651,13 @@ void MainWindow::on_actionOpen_triggered() {
     }
     try {
         if (filename.endsWith(".cube")) {
-            setFrame(cube::loadCube(filename.toStdString()), QFileInfo(filename).fileName());
+            setFrame(std::make_shared<const Frame3D<GLfloat>>(cube::loadCube(filename.toStdString())),
+                     QFileInfo(filename).fileName());
         } else {
-            setFrame(FrameLoader::load(filename.toStdString()), QFileInfo(filename).fileName());
+            const auto path = filename.toStdString();
+            loadFrame(QFileInfo(filename).fileName(), [path](const LoadPolicy &policy, LoadInfo *info) {
+                return FrameLoader::load(path, policy, info);
+            });
         }
         settings.setValue(FRAME_DIR_KEY, QFileInfo(filename).dir().absolutePath());
         settings.setValue(FRAME_FILTER_KEY, selectedFilter);
@@ -414,15 +667,60 @@ void MainWindow::on_actionOpen_triggered() {
     }
 }
 
+void MainWindow::on_actionAdd_Channel_triggered() {
+    QSettings settings;
+    QString selectedFilter = settings.value(FRAME_FILTER_KEY).toString();
+    auto filename = QFileDialog::getOpenFileName(this,
+                                                 "Add channel from frame file",
+                                                 settings.value(FRAME_DIR_KEY).toString(),
+                                                 "Frame files (*.frame);;Cube files (*.cube);;All files(*.*)",
+                                                 &selectedFilter);
+    if (filename.isNull()) {
+        return;
+    }
+    try {
+        // Channel is co-registered with the frame, so it's stretched over the same box whatever its size.
+        const auto path = filename.toStdString();
+        auto frame = std::make_shared<const Frame3D<GLfloat>>(filename.endsWith(".cube") ? cube::loadCube(path)
+                                                                                         : FrameLoader::load(path, getLoadPolicy()));
+        const auto channel = gl_widget->addChannel(frame);
+        setActiveChannel(channel);
+        gl_widget->update();
+        settings.setValue(FRAME_DIR_KEY, QFileInfo(filename).dir().absolutePath());
+        settings.setValue(FRAME_FILTER_KEY, selectedFilter);
+    }
+    catch (const std::exception &e) {
+        showError(e.what());
+    }
+}
+
+void MainWindow::on_actionClear_Channels_triggered() {
+    gl_widget->clearChannels();
+    setActiveChannel(0);
+    gl_widget->update();
+}
+
+void MainWindow::on_actionActive_Channel_triggered() {
+    bool ok = false;
+    const auto channel = QInputDialog::getInt(this, "Active Channel", "Channel for palettes and cutoff (0 - the frame):",
+                                              gl_widget->getActiveChannel(), 0, gl_widget->getChannelCount() - 1, 1, &ok);
+    if (ok) {
+        setActiveChannel(channel);
+    }
+}
+
 void MainWindow::on_actionOpen_Raw_triggered() {
     try {
         QSettings settings;
         RawDialog dlg(this, settings.value(FRAME_DIR_KEY).toString());
         if (dlg.exec() == QDialog::Accepted) {
             const auto filename = dlg.getFilename();
-            setFrame(FrameLoader::loadRaw(filename.toStdString(),
-                                          dlg.getWidth(), dlg.getHeight(), dlg.getDepth(),
-                                          dlg.getValueType()), QFileInfo(filename).fileName());
+            const auto path = filename.toStdString();
+            const auto width = dlg.getWidth(), height = dlg.getHeight(), depth = dlg.getDepth();
+            const auto type = dlg.getValueType();
+            loadFrame(QFileInfo(filename).fileName(), [=](const LoadPolicy &policy, LoadInfo *info) {
+                return FrameLoader::loadRaw(path, width, height, depth, type, policy, info);
+            });
             settings.setValue(FRAME_DIR_KEY, QFileInfo(filename).dir().absolutePath());
         }
     }
@@ -462,6 +760,77 @@ void MainWindow::on_actionCutoff_triggered() {
     }
 }
 
+void MainWindow::on_actionRandom_Seed_triggered() {
+    bool ok = false;
+    const auto seed = QInputDialog::getInt(this, "Random Seed", "Seed for random frames:",
+                                           random_seed, 0, std::numeric_limits<int>::max(), 1, &ok);
+    if (ok) {
+        setRandomSeed(seed);
+    }
+}
+
+void MainWindow::on_actionCache_Frames_on_Disk_triggered() {
+    enableDiskCache(ui->actionCache_Frames_on_Disk->isChecked());
+}
+
+void MainWindow::on_actionShow_Frame_Timings_triggered() {
+    showTimings(ui->actionShow_Frame_Timings->isChecked());
+}
+
+void MainWindow::on_actionSave_Frame_Timings_triggered() {
+    QSettings settings;
+    const auto filename = QFileDialog::getSaveFileName(this, "Save frame timings", settings.value(TIMINGS_DIR_KEY).toString(),
+                                                       "CSV files (*.csv)");
+    if (filename.isNull()) {
+        return;
+    }
+    try {
+        gl_widget->getProfiler().saveCsv(filename);
+        settings.setValue(TIMINGS_DIR_KEY, QFileInfo(filename).dir().absolutePath());
+    }
+    catch (const std::exception &e) {
+        showError(e.what());
+    }
+}
+
+void MainWindow::on_actionProgressive_Loading_triggered() {
+    enableProgressiveLoading(ui->actionProgressive_Loading->isChecked());
+}
+
+void MainWindow::on_actionVirtual_Texturing_triggered() {
+    enableVirtualTexturing(ui->actionVirtual_Texturing->isChecked());
+}
+
+void MainWindow::on_actionAtlas_Size_triggered() {
+    // Small atlas makes paging testable on any GPU.
+    bool ok = false;
+    const auto slots = QInputDialog::getInt(this, "Atlas Size", "Bricks per axis of the atlas (0 - by GPU memory budget):",
+                                            getSetting(ATLAS_SIZE_KEY, 0).toInt(), 0, 255, 1, &ok);
+    if (ok) {
+        setAtlasSize(slots);
+    }
+}
+
+void MainWindow::on_actionMemory_Budgets_triggered() {
+    // Files which don't fit the budgets are decimated on load.
+    bool ok = false;
+    const auto host_budget = QInputDialog::getInt(this, "Memory Budgets", "Host memory for a loaded frame and its derived data (MB):",
+                                                  getSetting(HOST_BUDGET_KEY, DEFAULT_HOST_BUDGET).toInt(),
+                                                  1, std::numeric_limits<int>::max(), 64, &ok);
+    if (!ok) {
+        return;
+    }
+    const auto gpu_budget = QInputDialog::getInt(this, "Memory Budgets", "GPU memory for the textures of a frame (MB):",
+                                                 getSetting(GPU_BUDGET_KEY, DEFAULT_GPU_BUDGET).toInt(),
+                                                 1, std::numeric_limits<int>::max(), 64, &ok);
+    if (!ok) {
+        return;
+    }
+    setSetting(HOST_BUDGET_KEY, host_budget);
+    setSetting(GPU_BUDGET_KEY, gpu_budget);
+    setAtlasSize(getSetting(ATLAS_SIZE_KEY, 0).toInt());
+}
+
 void MainWindow::on_actionRenderSlices_triggered() {
     setRenderer(std::make_shared<SliceRenderer>());
 }
@@ -470,6 +839,10 @@ void MainWindow::on_actionRenderRay_Casting_triggered() {
     setRenderer(std::make_shared<RayCastRenderer>());
 }
 
+void MainWindow::on_actionRenderCPU_Ray_Casting_triggered() {
+    setRenderer(std::make_shared<CpuRayCastRenderer>());
+}
+
 void MainWindow::on_actionShow_hide_Toolbar_triggered() {
     showToolbar(ui->actionShow_hide_Toolbar->isChecked());
 }
@@ -490,10 +863,18 @@ void MainWindow::on_actionCorrect_Scale_triggered() {
     enableCorrectScale(ui->actionCorrect_Scale->isChecked());
 }
 
+void MainWindow::on_actionKeep_Thin_Features_triggered() {
+    keepThinFeatures(ui->actionKeep_Thin_Features->isChecked());
+}
+
 void MainWindow::on_actionEnable_Jitter_triggered() {
     enableJitter(ui->actionEnable_Jitter->isChecked());
 }
 
+void MainWindow::on_actionEnable_Preintegration_triggered() {
+    enablePreintegration(ui->actionEnable_Preintegration->isChecked());
+}
+
 void MainWindow::on_actionReset_All_triggered() {
     resetSettings();
 }
@@ -6,9 +6,16 @@
 #include <QLabel>
 #include <QSlider>
 #include <QSpinBox>
+#include <QFutureWatcher>
+#include <QTimer>
+
+#include "frame_cache.h"
+#include "frame_loader.h"
+#include "prepared_frame.h"
 
 #include <vector>
 #include <memory>
+#include <functional>
 
 namespace Ui {
 class MainWindow;
@@ -32,12 +39,19 @@ signals:
     void stepMultiplierChanged(int);
     void enableLightingChanged(bool);
     void enableJitterChanged(bool);
+    void enablePreintegrationChanged(bool);
     void enableCorrectScaleChanged(bool);
+    void keepThinFeaturesChanged(bool);
     void showToolbarChanged(bool);
     void showStatusbarChanged(bool);
+    void enableDiskCacheChanged(bool);
+    void enableProgressiveLoadingChanged(bool);
+    void enableVirtualTexturingChanged(bool);
+    void showTimingsChanged(bool);
 
 private slots:
     void initGlWidget();
+    void onLoadStepFinished();
 
     void on_actionSector_triggered();
     void on_actionRandom_triggered();
@@ -48,6 +62,7 @@ private slots:
     void on_actionHelix_triggered();
     void on_actionHelicoid_triggered();
     void on_actionTorus_triggered();
+    void on_actionTorus_Shell_triggered();
     void on_actionBubbles_triggered();
     void on_actionPerlin_Noise_triggered();
     void on_actionPerlin_Noise_with_Octaves_triggered();
@@ -72,6 +87,10 @@ private slots:
 
     void on_actionOpen_triggered();
 
+    void on_actionAdd_Channel_triggered();
+    void on_actionClear_Channels_triggered();
+    void on_actionActive_Channel_triggered();
+
     void on_actionExit_triggered();
 
     void on_actionAbout_triggered();
@@ -80,8 +99,24 @@ private slots:
 
     void on_actionCutoff_triggered();
 
+    void on_actionRandom_Seed_triggered();
+
+    void on_actionCache_Frames_on_Disk_triggered();
+
+    void on_actionMemory_Budgets_triggered();
+
+    void on_actionProgressive_Loading_triggered();
+
+    void on_actionVirtual_Texturing_triggered();
+
+    void on_actionAtlas_Size_triggered();
+
+    void on_actionShow_Frame_Timings_triggered();
+    void on_actionSave_Frame_Timings_triggered();
+
     void on_actionRenderSlices_triggered();
     void on_actionRenderRay_Casting_triggered();
+    void on_actionRenderCPU_Ray_Casting_triggered();
 
     void on_actionShow_hide_Toolbar_triggered();
     void on_actionShow_hide_Statusbar_triggered();
@@ -92,13 +127,27 @@ private slots:
 
     void on_actionCorrect_Scale_triggered();
 
+    void on_actionKeep_Thin_Features_triggered();
+
     void on_actionEnable_Jitter_triggered();
 
+    void on_actionEnable_Preintegration_triggered();
+
     void on_actionReset_All_triggered();
 
     void on_actionHelp_triggered();
 
 private:
+    // Loads a file with the given limits; info receives what has actually been loaded.
+    using FrameLoadFunc = std::function<Frame3D<GLfloat>(const LoadPolicy &policy, LoadInfo *info)>;
+
+    // Result of a background load step; the frame is prepared for the viewer in the same task.
+    struct LoadedFrame {
+        PreparedFrame frame;
+        LoadInfo info;
+        QString error;
+    };
+
     void initMenu();
     void initStatusbar();
     void initToolbar();
@@ -106,30 +155,62 @@ private:
     void initSettings();
     void resetSettings();
 
-    void setFrame(const Frame3D<GLfloat> &frame, const QString &title = "");
+    // Replaces the frame and cancels refinement of a progressively loaded one.
+    void setFrame(std::shared_ptr<const Frame3D<GLfloat>> frame, const QString &title = "", const LoadInfo &info = LoadInfo());
+    void showFrame(const PreparedFrame &frame, const QString &title, const LoadInfo &info);
+    // With progressive loading a coarse preview is shown at once and then refined in the background.
+    void loadFrame(const QString &title, FrameLoadFunc load_func);
+    void loadNextStep();
+    void cancelLoading();
+    void setGeneratedFrame(const QString &title, const std::vector<double> &params, std::uint64_t seed,
+                           std::function<Frame3D<GLfloat>(size_t)> generator);
     void setColorPalette(const std::vector<QVector3D> &palette);
     void setOpacityPalette(const std::vector<GLfloat> &palette);
     void setRenderer(std::shared_ptr<Renderer> renderer);
     void setCutoff(float low, float high);
+    // Palettes and cutoff are applied to this channel (0 is the frame).
+    void setActiveChannel(int channel);
     void enableLighting(bool enabled);
     void enableJitter(bool enabled);
+    void enablePreintegration(bool enabled);
     void enableCorrectScale(bool enabled);
+    // Coarse levels of detail are built by maximum instead of average, so thin bright features don't vanish.
+    void keepThinFeatures(bool enabled);
     void setStepMultiplier(int multiplier);
+    void setRandomSeed(int seed);
+    void enableDiskCache(bool enabled);
+    void enableProgressiveLoading(bool enabled);
+    void enableVirtualTexturing(bool enabled);
+    void setAtlasSize(int slots_per_axis);
 
     void showToolbar(bool show);
     void showStatusbar(bool show);
+    // Rolling frame timings in the status bar.
+    void showTimings(bool show);
     void enableAutorotation(bool enabled);
 
     std::pair<float, float> getCutoff() const;
 
+    LoadPolicy getLoadPolicy() const;
+
     void showError(QString message);
 
 private:
     Ui::MainWindow *ui;
     MyOpenGLWidget *gl_widget;
     QString default_title;
-    QLabel *size_label, *cutoff_label;
+    QLabel *size_label, *cutoff_label, *upload_label, *timing_label;
+    QTimer timing_timer;
     QSlider *slider_low, *slider_high;
     QSpinBox *step_mult_box;
+    int random_seed {0};
+    FrameCache frame_cache;
+
+    bool progressive_loading {false};
+    bool virtual_texturing {false};
+    QFutureWatcher<LoadedFrame> load_watcher;
+    std::vector<LoadPolicy> load_steps; // remaining refinement steps, from coarse to fine
+    FrameLoadFunc load_func;
+    QString load_title;
 };
 
@@ -1,9 +1,12 @@
 #include "my_opengl_widget.h"
 #include "frame3d.h"
 #include "frame_util.h"
+#include "gradient_volume.h"
+#include "volume_pyramid.h"
 #include "palette_util.h"
 #include "render/slice_renderer.h"
 #include "render/ray_cast_renderer.h"
+#include "render/cpu_ray_cast_renderer.h"
 
 #include <QOpenGLContext>
 #include <QOpenGLFunctions>
@@ -11,18 +14,22 @@
 #include <QMouseEvent>
 #include <QMessageBox>
 
+#include <algorithm>
 #include <cmath>
 #include <exception>
+#include <stdexcept>
+#include <string>
 
 MyOpenGLWidget::MyOpenGLWidget(QWidget *parent) :
     QOpenGLWidget(parent),
-    data_texture(QOpenGLTexture::Target3D),
-    color_texture(QOpenGLTexture::Target1D),
-    opacity_texture(QOpenGLTexture::Target1D)
+    data_volume(QOpenGLTexture::R32F, QOpenGLTexture::Red, QOpenGLTexture::Float32, sizeof(GLfloat)),
+    gradient_volume(QOpenGLTexture::RGBA8_UNorm, QOpenGLTexture::RGBA, QOpenGLTexture::UInt32_RGBA8_Rev, sizeof(GLuint)),
+    brick_atlas(std::make_shared<BrickAtlas>())
 {
     QSurfaceFormat format;
     format.setDepthBufferSize(24);
     format.setStencilBufferSize(8);
+    format.setVersion(3, 3);
     format.setProfile(QSurfaceFormat::CoreProfile);
     format.setSamples(4);
     setFormat(format);
@@ -30,12 +37,29 @@ MyOpenGLWidget::MyOpenGLWidget(QWidget *parent) :
     renderer = std::make_shared<RayCastRenderer>();
 
     connect(&rotation_timer, &QTimer::timeout, this, &MyOpenGLWidget::onTimer);
+
+    interaction_timer.setSingleShot(true);
+    connect(&interaction_timer, &QTimer::timeout, this, &MyOpenGLWidget::onInteractionEnd);
+}
+
+MyOpenGLWidget::~MyOpenGLWidget() {
+    // Free GL resources while the context is still alive.
+    makeCurrent();
+    data_volume.release();
+    gradient_volume.release();
+    brick_atlas->release();
+    channel_texture.reset();
+    profiler.release();
+    renderer.reset();
+    doneCurrent();
 }
 
 void MyOpenGLWidget::initializeGL() {
     auto *gl = context()->functions();
 
     gl->glEnable(GL_MULTISAMPLE);
+    gl->glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &max_texture_size);
+    profiler.init();
 
     initView();
     initRenderer();
@@ -57,9 +81,20 @@ void MyOpenGLWidget::initView() {
 void MyOpenGLWidget::initRenderer() {
     try {
         renderer->init(context()->functions());
-        renderer->setDataTexture(&data_texture);
-        renderer->setColorTexture(&color_texture);
-        renderer->setOpacityTexture(&opacity_texture);
+        renderer->setProfiler(&profiler);
+        renderer->setDataTexture(data_volume.texture());
+        renderer->setGradientTexture(isGradientReady() ? gradient_volume.texture() : nullptr);
+        renderer->setBrickVolume(data_volume.isUploading() ? nullptr : brick_volume);
+        renderer->setBrickAtlas(virtual_texturing ? brick_atlas : nullptr);
+        renderer->setColorPalette(color_values);
+        renderer->setOpacityPalette(opacity_values);
+        renderer->setChannelTexture(channel_texture.get(), static_cast<int>(channels.size()));
+        for (size_t i = 0; i < channels.size(); i++) {
+            const auto channel = static_cast<int>(i) + 1;
+            renderer->setChannelColorPalette(channel, channels[i].colors);
+            renderer->setChannelOpacityPalette(channel, channels[i].opacities);
+        }
+        renderer->enablePreintegration(preintegration_enabled);
         renderer->enableLighting(lighting_enabled);
         renderer->enableJitter(jitter_enabled);
         renderer->setStepMultiplier(step_multiplier);
@@ -69,48 +104,281 @@ void MyOpenGLWidget::initRenderer() {
     }
 }
 
-void MyOpenGLWidget::setFrame(const Frame3D<GLfloat> &data) {
-    data_texture.destroy();
-    data_texture.setSize(static_cast<int>(data.width()),
-                       static_cast<int>(data.height()),
-                       static_cast<int>(data.depth()));
-    data_texture.setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
-    data_texture.setWrapMode(QOpenGLTexture::ClampToEdge);
-    //data_texture.setAutoMipMapGenerationEnabled(true);
-    data_texture.setMaximumAnisotropy(16.0f);
-    data_texture.setBorderColor(0.0f, 0.0f, 0.0f, 0.0f);
-    data_texture.setFormat(QOpenGLTexture::R32F);
-    data_texture.allocateStorage();
-    data_texture.setData(QOpenGLTexture::Red, QOpenGLTexture::Float32, data.data());
+void MyOpenGLWidget::setFrame(std::shared_ptr<const Frame3D<GLfloat>> data, const QVector3D &extent) {
+    // Done on the CPU without the GL context current, uploads are timed while painting.
+    profiler.begin(FrameProfiler::SET_FRAME, false);
+    const auto prepared = prepareFrame(data, frameOptions(), preparedFrame());
+    profiler.end(FrameProfiler::SET_FRAME, false);
+    setFrame(prepared, extent);
+}
+
+void MyOpenGLWidget::setFrame(const PreparedFrame &prepared, const QVector3D &extent) {
+    // Settings may have changed while the frame was being prepared in the background.
+    if (prepared.options != frameOptions()) {
+        setFrame(prepared.frame, extent);
+        return;
+    }
+    profiler.begin(FrameProfiler::SET_FRAME, false);
+    // A change of the current frame is uploaded by slabs: only the changed slices and coarser slices covering them.
+    const auto slab_update = (prepared.base && prepared.base == frame);
+    const auto z_begin = prepared.changed_begin, z_end = prepared.changed_end;
+    frame = prepared.frame;
+    frame_options = prepared.options;
+    frame_extent = (extent.isNull() ? QVector3D(frame->width(), frame->height(), frame->depth()) : extent);
+    brick_volume = prepared.bricks;
+    pyramid = prepared.pyramid;
+    if (virtual_texturing) {
+        // Bricks are paged in while rendering, so the frame is shown at once.
+        if (!slab_update) {
+            brick_atlas->setFrame(frame);
+        } else if (z_begin < z_end) {
+            brick_atlas->updateFrameSlab(frame, z_begin, z_end);
+        }
+        shown_extent = frame_extent;
+    } else if (isCpuRendering()) {
+        // CPU ray caster samples the frame in host memory, so it's shown at once without uploads.
+        shown_extent = frame_extent;
+    } else if (!slab_update) {
+        data_volume.setFrame(frame, pyramid);
+    } else if (z_begin < z_end) {
+        data_volume.updateFrameSlab(frame, pyramid, z_begin, z_end);
+    }
+    const auto gradient_changed = (prepared.gradient != gradient_frame);
+    gradient_frame = prepared.gradient;
+    if (gradient_frame && gradient_changed && !isCpuRendering()) {
+        if (slab_update) {
+            // Central differences of the neighbouring slices depend on the changed ones too.
+            gradient_volume.updateFrameSlab(gradient_frame, (z_begin > 0 ? z_begin - 1 : 0), std::min(z_end + 1, frame->depth()));
+        } else {
+            gradient_volume.setFrame(gradient_frame);
+        }
+    }
+    profiler.end(FrameProfiler::SET_FRAME, false);
+}
+
+PreparedFrame MyOpenGLWidget::preparedFrame() const {
+    PreparedFrame prepared;
+    if (frame) {
+        prepared.frame = frame;
+        prepared.options = frame_options;
+        prepared.bricks = brick_volume;
+        prepared.pyramid = pyramid;
+        prepared.gradient = gradient_frame;
+    }
+    return prepared;
+}
+
+FrameOptions MyOpenGLWidget::frameOptions() const {
+    FrameOptions options;
+    options.pyramid_filter = pyramid_filter;
+    // Brick atlas has no mip levels; virtual texture has no gradient volume: gradients are computed by shaders.
+    options.pyramid = !virtual_texturing;
+    options.gradient = lighting_enabled && !virtual_texturing;
+    return options;
+}
+
+double MyOpenGLWidget::hostBytesPerVoxel() const {
+    // The frame and brick ranges, the pyramid (1/7 of the frame) and gradients if they're built.
+    const auto options = frameOptions();
+    const auto brick_size = 8.0;
+    auto bytes = sizeof(GLfloat) + sizeof(BrickVolume::Range) / (brick_size * brick_size * brick_size);
+    if (options.pyramid) {
+        bytes += sizeof(GLfloat) / 7.0;
+    }
+    if (options.gradient) {
+        bytes += sizeof(GLuint);
+    }
+    return bytes;
+}
+
+double MyOpenGLWidget::gpuBytesPerVoxel() const {
+    // Data texture with its mip levels, and the gradient texture for lighting; the CPU ray caster uploads none.
+    if (isCpuRendering()) {
+        return 0.0;
+    }
+    auto bytes = sizeof(GLfloat) * 8.0 / 7.0;
+    if (lighting_enabled) {
+        bytes += sizeof(GLuint);
+    }
+    return bytes;
+}
+
+bool MyOpenGLWidget::isCpuRendering() const {
+    return std::dynamic_pointer_cast<CpuRayCastRenderer>(renderer) != nullptr;
+}
+
+void MyOpenGLWidget::updateGradientFrame() {
+    // Gradients are needed only for lighting; they are computed when it's enabled.
+    // Virtual texture has no gradient volume: gradients are computed by shaders.
+    if (!lighting_enabled || !frame || virtual_texturing) {
+        gradient_frame.reset();
+        frame_options.gradient = false;
+        return;
+    }
+    gradient_frame = std::make_shared<const GradientFrame>(computeGradient(*frame));
+    // CPU ray caster samples it in host memory.
+    if (!isCpuRendering()) {
+        gradient_volume.setFrame(gradient_frame);
+    }
+    frame_options.gradient = true;
+}
+
+bool MyOpenGLWidget::isGradientReady() const {
+    // Gradient should match the data which is currently rendered.
+    return gradient_frame && gradient_volume.texture() && !data_volume.isUploading() && !gradient_volume.isUploading();
+}
+
+void MyOpenGLWidget::updateChannelTexture() {
+    if (!channels_dirty) {
+        return;
+    }
+    channels_dirty = false;
+    channel_texture.reset();
+    if (!channels.empty()) {
+        // Channels are packed at the size of the first one; half floats are precise enough for normalized values.
+        std::vector<std::shared_ptr<const Frame3D<GLfloat>>> frames;
+        for (const auto &channel: channels) {
+            frames.push_back(channel.frame);
+        }
+        const auto packed = packChannels(frames);
+        const auto &first = *channels.front().frame;
+        channel_texture = std::make_unique<QOpenGLTexture>(QOpenGLTexture::Target3D);
+        channel_texture->setSize(static_cast<int>(first.width()), static_cast<int>(first.height()), static_cast<int>(first.depth()));
+        channel_texture->setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
+        channel_texture->setWrapMode(QOpenGLTexture::ClampToEdge);
+        channel_texture->setFormat(QOpenGLTexture::RGBA16F);
+        channel_texture->allocateStorage();
+        channel_texture->setData(QOpenGLTexture::RGBA, QOpenGLTexture::Float32, packed.data());
+    }
+    if (renderer) {
+        renderer->setChannelTexture(channel_texture.get(), static_cast<int>(channels.size()));
+    }
+}
+
+void MyOpenGLWidget::updateTextures() {
+    updateChannelTexture();
+
+    // GPU memory of the mode which is not in use is freed; the CPU ray caster needs no volume textures.
+    const auto cpu_rendering = isCpuRendering();
+    if ((virtual_texturing || cpu_rendering) && (data_volume.texture() || data_volume.isUploading())) {
+        data_volume.release();
+        gradient_volume.release();
+        emit uploadProgress(100);
+    } else if (!virtual_texturing && brick_atlas->texture()) {
+        brick_atlas->release();
+    }
+    if (virtual_texturing || cpu_rendering) {
+        if (renderer) {
+            renderer->setDataTexture(nullptr);
+            renderer->setGradientTexture(nullptr);
+            renderer->setBrickVolume(brick_volume);
+        }
+        return;
+    }
+    if (!data_volume.isUploading() && !gradient_volume.isUploading()) {
+        return;
+    }
+    if (data_volume.isUploading()) {
+        data_volume.process(upload_budget);
+        if (!data_volume.isUploading()) {
+            shown_extent = frame_extent; // scale changes together with the shown data
+        }
+        emit uploadProgress(static_cast<int>(data_volume.progress() * 100.0f));
+    }
+    if (gradient_volume.isUploading()) {
+        gradient_volume.process(upload_budget);
+    }
+    if (renderer) {
+        renderer->setDataTexture(data_volume.texture());
+        renderer->setGradientTexture(isGradientReady() ? gradient_volume.texture() : nullptr);
+        // Bricks describe the new data, so they are not used until it's completely uploaded.
+        renderer->setBrickVolume(data_volume.isUploading() ? nullptr : brick_volume);
+    }
+    if (data_volume.isUploading() || gradient_volume.isUploading()) {
+        update(); // continue uploading on the next frame
+    }
+}
+
+int MyOpenGLWidget::addChannel(std::shared_ptr<const Frame3D<GLfloat>> data) {
+    if (getChannelCount() >= Renderer::max_channels) {
+        throw std::runtime_error("All " + std::to_string(Renderer::max_channels) + " channels are in use");
+    }
+    // Channels are told apart by color until their palettes are changed.
+    static const QVector3D tints[] = {QVector3D(1.0f, 0.2f, 0.2f), QVector3D(0.2f, 1.0f, 0.2f), QVector3D(0.3f, 0.5f, 1.0f)};
+    Channel channel;
+    channel.frame = data;
+    channel.colors = {tints[channels.size()]};
+    channel.opacities = {0.0f, 1.0f};
+    channels.push_back(channel);
+    channels_dirty = true;
+
+    const auto index = getChannelCount() - 1;
+    if (renderer) {
+        renderer->setChannelColorPalette(index, channel.colors);
+        renderer->setChannelOpacityPalette(index, channel.opacities);
+    }
+    return index;
+}
+
+void MyOpenGLWidget::clearChannels() {
+    channels.clear();
+    channels_dirty = true;
+    active_channel = 0;
+}
+
+void MyOpenGLWidget::setActiveChannel(int channel) {
+    active_channel = std::min(std::max(channel, 0), getChannelCount() - 1);
 }
 
 void MyOpenGLWidget::setColorPalette(const std::vector<QVector3D> &colors) {
-    color_texture.destroy();
-    color_texture.setSize(static_cast<int>(colors.size()));
-    color_texture.setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
-    color_texture.setWrapMode(QOpenGLTexture::ClampToEdge);
-    color_texture.setFormat(QOpenGLTexture::RGB8_UNorm);
-    color_texture.allocateStorage();
-    color_texture.setData(QOpenGLTexture::RGB, QOpenGLTexture::Float32, colors.data());
+    if (active_channel > 0) {
+        channels[static_cast<size_t>(active_channel - 1)].colors = colors;
+        if (renderer) {
+            renderer->setChannelColorPalette(active_channel, colors);
+        }
+        return;
+    }
+    color_values = colors;
+    if (renderer) {
+        renderer->setColorPalette(colors);
+    }
 }
 
 void MyOpenGLWidget::setOpacityPalette(const std::vector<GLfloat> &values) {
-    opacity_texture.destroy();
-    opacity_texture.setSize(static_cast<int>(values.size()));
-    opacity_texture.setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
-    opacity_texture.setWrapMode(QOpenGLTexture::ClampToEdge);
-    opacity_texture.setFormat(QOpenGLTexture::R32F);
-    opacity_texture.allocateStorage();
-    opacity_texture.setData(QOpenGLTexture::Red, QOpenGLTexture::Float32, values.data());
+    if (active_channel > 0) {
+        channels[static_cast<size_t>(active_channel - 1)].opacities = values;
+        if (renderer) {
+            renderer->setChannelOpacityPalette(active_channel, values);
+        }
+        return;
+    }
+    opacity_values = values;
+    if (renderer) {
+        renderer->setOpacityPalette(values);
+    }
 }
 
 void MyOpenGLWidget::setRenderer(std::shared_ptr<Renderer> rend) {
+    const auto was_cpu_rendering = isCpuRendering();
     renderer = rend;
     update_renderer = true;
+    // Volume textures aren't uploaded for the CPU ray caster, so they're uploaded when a GL renderer takes over.
+    if (was_cpu_rendering && !isCpuRendering() && frame && !virtual_texturing) {
+        data_volume.setFrame(frame, pyramid);
+        if (gradient_frame) {
+            gradient_volume.setFrame(gradient_frame);
+        } else {
+            updateGradientFrame();
+        }
+    }
 }
 
 void MyOpenGLWidget::enableLighting(bool enabled) {
     lighting_enabled = enabled;
+    if (enabled && frame && !gradient_frame) {
+        updateGradientFrame();
+        update();
+    }
     if (renderer) {
         renderer->enableLighting(enabled);
     }
@@ -123,6 +391,13 @@ void MyOpenGLWidget::enableJitter(bool enabled) {
     }
 }
 
+void MyOpenGLWidget::enablePreintegration(bool enabled) {
+    preintegration_enabled = enabled;
+    if (renderer) {
+        renderer->enablePreintegration(enabled);
+    }
+}
+
 void MyOpenGLWidget::enableAutorotation(bool enabled) {
     if (enabled) {
         rotation_timer.start(timer_interval);
@@ -131,6 +406,40 @@ void MyOpenGLWidget::enableAutorotation(bool enabled) {
     }
 }
 
+void MyOpenGLWidget::enableVirtualTexturing(bool enabled) {
+    if (enabled == virtual_texturing) {
+        return;
+    }
+    virtual_texturing = enabled;
+    if (renderer) {
+        renderer->setBrickAtlas(enabled ? brick_atlas : nullptr);
+    }
+    if (frame) {
+        setFrame(frame, frame_extent);
+    }
+    update();
+}
+
+void MyOpenGLWidget::setAtlasSize(size_t slots_per_axis) {
+    brick_atlas->setSlotsPerAxis(slots_per_axis);
+    update();
+}
+
+void MyOpenGLWidget::setPyramidFilter(PyramidFilter filter) {
+    if (filter == pyramid_filter) {
+        return;
+    }
+    pyramid_filter = filter;
+    // Brick atlas has no mip levels.
+    if (frame && !virtual_texturing) {
+        pyramid = std::make_shared<const FramePyramid>(buildPyramid(*frame, pyramid_filter));
+        if (!isCpuRendering()) {
+            data_volume.setFrame(frame, pyramid);
+        }
+    }
+    frame_options.pyramid_filter = filter;
+}
+
 void MyOpenGLWidget::enableCorrectScale(bool enabled) {
     correct_scale = enabled;
 }
@@ -144,19 +453,23 @@ QColor MyOpenGLWidget::getBackgroundColor() const {
 }
 
 void MyOpenGLWidget::setCutoff(float low, float high) {
-    cutoff_low = low;
-    cutoff_high = high;
+    setCutoffLow(low);
+    setCutoffHigh(high);
 }
 
 void MyOpenGLWidget::setCutoffLow(float low) {
-    cutoff_low = low;
+    (active_channel > 0 ? channels[static_cast<size_t>(active_channel - 1)].cutoff_low : cutoff_low) = low;
 }
 
 void MyOpenGLWidget::setCutoffHigh(float high) {
-    cutoff_high = high;
+    (active_channel > 0 ? channels[static_cast<size_t>(active_channel - 1)].cutoff_high : cutoff_high) = high;
 }
 
 std::pair<float, float> MyOpenGLWidget::getCutoff() const {
+    if (active_channel > 0) {
+        const auto &channel = channels[static_cast<size_t>(active_channel - 1)];
+        return std::make_pair(channel.cutoff_low, channel.cutoff_high);
+    }
     return std::make_pair(cutoff_low, cutoff_high);
 }
 
@@ -175,7 +488,23 @@ void MyOpenGLWidget::resizeGL(int width, int height) {
     initView();
 }
 
+QString MyOpenGLWidget::renderState() const {
+    const auto render_mode = (std::dynamic_pointer_cast<SliceRenderer>(renderer) ? "slices" :
+                              std::dynamic_pointer_cast<CpuRayCastRenderer>(renderer) ? "cpu" : "raycast");
+    return QString("renderer=%0 size=%1x%2 step=%3 lighting=%4 jitter=%5 preintegration=%6 virtual=%7 channels=%8")
+            .arg(render_mode).arg(width()).arg(height()).arg(step_multiplier)
+            .arg(lighting_enabled).arg(jitter_enabled).arg(preintegration_enabled).arg(virtual_texturing).arg(channels.size());
+}
+
 void MyOpenGLWidget::paintGL() {
+    profiler.beginFrame();
+    profiler.begin(FrameProfiler::PAINT);
+    paintFrame();
+    profiler.end(FrameProfiler::PAINT);
+    profiler.endFrame(renderState());
+}
+
+void MyOpenGLWidget::paintFrame() {
     auto *gl = context()->functions();
 
     gl->glClearColor(static_cast<GLfloat>(background_color.redF()),
@@ -183,6 +512,10 @@ void MyOpenGLWidget::paintGL() {
                      static_cast<GLfloat>(background_color.blueF()), 1.0f);
     gl->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    profiler.begin(FrameProfiler::UPLOAD);
+    updateTextures();
+    profiler.end(FrameProfiler::UPLOAD);
+
     if (!renderer) {
         return;
     }
@@ -193,10 +526,8 @@ void MyOpenGLWidget::paintGL() {
 
     QMatrix4x4 scale;
     if (correct_scale) {
-        const auto md = static_cast<GLfloat>(std::max(data_texture.width(), std::max(data_texture.height(), data_texture.depth())));
-        scale.scale(static_cast<GLfloat>(data_texture.width()) / md,
-                    static_cast<GLfloat>(data_texture.height()) / md,
-                    static_cast<GLfloat>(data_texture.depth()) / md);
+        const auto md = std::max(shown_extent.x(), std::max(shown_extent.y(), shown_extent.z()));
+        scale.scale(shown_extent / md);
     }
 
     if (update_renderer) {
@@ -206,11 +537,39 @@ void MyOpenGLWidget::paintGL() {
 
     renderer->setMVP(rotate * scale * model_matrix, view_matrix, projection_matrix);
     renderer->setCutoff(cutoff_low, cutoff_high);
+    for (size_t i = 0; i < channels.size(); i++) {
+        renderer->setChannelCutoff(static_cast<int>(i) + 1, channels[i].cutoff_low, channels[i].cutoff_high);
+    }
+    if (auto cpu_renderer = std::dynamic_pointer_cast<CpuRayCastRenderer>(renderer)) {
+        // Nothing is uploaded for it, so a new frame is shown at once.
+        cpu_renderer->setFrame(frame, pyramid);
+        cpu_renderer->setGradient(gradient_frame);
+    }
     renderer->render(gl);
+
+    if (renderer->isPaging()) {
+        update(); // render again with the paged in bricks
+    }
 }
 
 void MyOpenGLWidget::onTimer() {
     rotation_y_angle += 1.0f;
+    startInteraction();
+    update();
+}
+
+void MyOpenGLWidget::startInteraction() {
+    // Coarser level of detail is rendered while the view is changing.
+    if (renderer) {
+        renderer->setInteracting(true);
+    }
+    interaction_timer.start(interaction_timeout);
+}
+
+void MyOpenGLWidget::onInteractionEnd() {
+    if (renderer) {
+        renderer->setInteracting(false);
+    }
     update();
 }
 
@@ -225,6 +584,7 @@ void MyOpenGLWidget::mouseMoveEvent(QMouseEvent *event) {
     rotation_y_angle += float(event->pos().x() - mouse_pos.x());
     rotation_x_angle += float(event->pos().y() - mouse_pos.y());
     mouse_pos = event->pos();
+    startInteraction();
     update();
 }
 
@@ -232,5 +592,6 @@ void MyOpenGLWidget::wheelEvent(QWheelEvent *event) {
     const auto coeff = (event->angleDelta().y() > 0 ? 1.0f : -1.0f);
     const auto shift = coeff*QVector3D(0.2f, 0.2f, 0.2f);
     view_matrix.translate(shift);
+    startInteraction();
     update();
 }
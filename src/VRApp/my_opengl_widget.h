@@ -10,27 +10,80 @@
 
 #include "frame3d.h"
 #include "render/renderer.h"
+#include "brick_volume.h"
+#include "gradient_volume.h"
+#include "prepared_frame.h"
+#include "volume_pyramid.h"
+#include "render/volume_texture.h"
+#include "render/brick_atlas.h"
+#include "render/frame_profiler.h"
 
 class MyOpenGLWidget : public QOpenGLWidget {
     Q_OBJECT
 
 public:
     explicit MyOpenGLWidget(QWidget *parent=nullptr);
+    ~MyOpenGLWidget() override;
+
+    // Frame is uploaded in chunks over several frames; the previous one is shown until then.
+    // Extent is the size of the volume for correct scale (e.g. of the original data if the frame is decimated);
+    // null extent means the frame size.
+    void setFrame(std::shared_ptr<const Frame3D<GLfloat>> data, const QVector3D &extent = QVector3D());
+    // Frame with its derived data computed in advance (e.g. in a loading thread), so only uploads are left.
+    // If the settings have changed since then, the data is recomputed.
+    void setFrame(const PreparedFrame &prepared, const QVector3D &extent = QVector3D());
+    // Settings for prepareFrame() of the frames to be shown.
+    FrameOptions frameOptions() const;
+    // Current frame with its data, for prepareFrame() to update only what a new frame of the same size changes.
+    PreparedFrame preparedFrame() const;
+    // Co-registered volume shown together with the frame in the same pass, with its own transfer function.
+    // Returns its channel number (the frame is channel 0); throws if all channels are in use.
+    int addChannel(std::shared_ptr<const Frame3D<GLfloat>> data);
+    void clearChannels();
+    // Number of channels including the frame.
+    int getChannelCount() const {
+        return static_cast<int>(channels.size()) + 1;
+    }
+    // Palettes and cutoff are applied to this channel.
+    void setActiveChannel(int channel);
+    int getActiveChannel() const {
+        return active_channel;
+    }
 
-    void setFrame(const Frame3D<GLfloat> &data);
     void setColorPalette(const std::vector<QVector3D> &colors);
     void setOpacityPalette(const std::vector<GLfloat> &values);
     void setRenderer(std::shared_ptr<Renderer> rend);
     void enableLighting(bool enabled);
     void enableJitter(bool enabled);
+    void enablePreintegration(bool enabled);
     void enableCorrectScale(bool enabled);
+    // Filter of the coarser levels of detail; the pyramid of the current frame is rebuilt.
+    void setPyramidFilter(PyramidFilter filter);
     void setStepMultiplier(int multiplier);
     void enableAutorotation(bool enabled);
+    // Frame is paged into a brick atlas on demand instead of being uploaded as a whole.
+    void enableVirtualTexturing(bool enabled);
+    void setAtlasSize(size_t slots_per_axis);
+
+    // Memory a frame takes per voxel with the data derived from it under the current settings,
+    // for load policies to decimate frames by.
+    double hostBytesPerVoxel() const;
+    double gpuBytesPerVoxel() const;
 
     size_t getFrameSize() const {
         return frame_size;
     }
 
+    // Max size of a 3D texture, known after initialization (zero before).
+    int getMaxTextureSize() const {
+        return max_texture_size;
+    }
+
+    // Timings of painted frames.
+    const FrameProfiler &getProfiler() const {
+        return profiler;
+    }
+
     void setBackgroundColor(QColor color);
     QColor getBackgroundColor() const;
 
@@ -41,6 +94,7 @@ public:
 
 signals:
     void initialized();
+    void uploadProgress(int percent);
 
 protected:
     virtual void initializeGL() override;
@@ -53,26 +107,65 @@ protected:
     void wheelEvent(QWheelEvent *event) override;
 
 private:
+    void paintFrame();
     void initView();
     void initRenderer();
+    void updateTextures();
+    void updateChannelTexture();
+    void updateGradientFrame();
+    bool isGradientReady() const;
+    // The CPU ray caster samples frames in host memory, so volume textures aren't uploaded for it.
+    bool isCpuRendering() const;
+    // Settings which affect the cost of a frame, for its timing record.
+    QString renderState() const;
 
     void onTimer();
+    void startInteraction();
+    void onInteractionEnd();
 
 private:
-    QOpenGLTexture data_texture, color_texture, opacity_texture;
+    // Extra channel of co-registered volumes with its transfer function.
+    struct Channel {
+        std::shared_ptr<const Frame3D<GLfloat>> frame;
+        std::vector<QVector3D> colors;
+        std::vector<GLfloat> opacities;
+        float cutoff_low {0.0f}, cutoff_high {1.0f};
+    };
+
+    std::vector<QVector3D> color_values;
+    std::vector<GLfloat> opacity_values;
+
+    std::shared_ptr<const Frame3D<GLfloat>> frame;
+    std::shared_ptr<const FramePyramid> pyramid;
+    FrameOptions frame_options; // which the derived data of the frame has been prepared with
+    QVector3D frame_extent, shown_extent {1.0f, 1.0f, 1.0f};
+    std::shared_ptr<const GradientFrame> gradient_frame;
+    std::shared_ptr<const BrickVolume> brick_volume;
+    VolumeTexture data_volume, gradient_volume;
+    std::shared_ptr<BrickAtlas> brick_atlas;
+    std::vector<Channel> channels;
+    std::unique_ptr<QOpenGLTexture> channel_texture; // channels packed into components
+    int active_channel {0};
+    bool channels_dirty = false;
+    size_t upload_budget {32*1024*1024}; // max bytes to upload per frame
 
     QMatrix4x4 model_matrix, view_matrix, projection_matrix;
 
     std::shared_ptr<Renderer> renderer;
+    FrameProfiler profiler;
 
     float rotation_y_angle {0.0f}, rotation_x_angle {0.0f};
 
     QTimer rotation_timer;
     int timer_interval {60};
 
+    QTimer interaction_timer;
+    int interaction_timeout {300};
+
     QPoint mouse_pos {0, 0};
 
     size_t frame_size {256};
+    int max_texture_size {0};
 
     QColor background_color {0, 0, 25};
 
@@ -83,6 +176,9 @@ private:
     bool update_renderer = false;
     bool lighting_enabled = false;
     bool correct_scale = false;
-    bool jitter_enabled = false;    
+    bool jitter_enabled = false;
+    bool preintegration_enabled = false;
+    bool virtual_texturing = false;
+    PyramidFilter pyramid_filter = PF_BOX;
 };
 
@@ -1,5 +1,7 @@
 #include "palette_util.h"
 
+#include <cmath>
+
 std::vector<QVector3D> makeRainbowPalette() {
     return {        
         QVector3D(1.0f, 0.0f, 1.0f),
@@ -30,4 +32,14 @@ std::vector<QVector3D> makeMonochromePalette() {
     };
 }
 
+std::vector<GLfloat> makeDefaultOpacityPalette() {
+    return {0.0f, 0.001f, 0.002f, 0.003f, 0.01f, 0.02f, 0.05f, 1.0f};
+}
 
+std::vector<GLfloat> makePowOpacityPalette(int n) {
+    return makeOpacityPalette(1024, [n](const GLfloat &x) {return std::pow(x, n);});
+}
+
+std::vector<GLfloat> makeLogOpacityPalette(float step) {
+    return makeOpacityPalette(1024, [step](const GLfloat &x) {return std::log(x + step) / std::log(1.0f + step);});
+}
@@ -21,3 +21,8 @@ std::vector<GLfloat> makeOpacityPalette(size_t size, Func func) {
     }
     return values;
 }
+
+std::vector<GLfloat> makeDefaultOpacityPalette();
+// Opacity is x^n of the value.
+std::vector<GLfloat> makePowOpacityPalette(int n);
+std::vector<GLfloat> makeLogOpacityPalette(float step = 1.0f);
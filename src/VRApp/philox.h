@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+/*
+ * Counter-based random number generator Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3").
+ * Output is a pure function of (key, counter), so each voxel can draw its own numbers
+ * without any shared state, and results do not depend on the order of evaluation.
+ */
+class Philox4x32 {
+public:
+    using Counter = std::array<std::uint32_t, 4>;
+    using Key = std::array<std::uint32_t, 2>;
+
+    explicit Philox4x32(std::uint64_t seed) :
+        key {{static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32)}}
+    {
+    }
+
+    Counter operator()(Counter ctr) const {
+        Key k = key;
+        for (int r = 0; r < 10; r++) {
+            ctr = round(ctr, k);
+            k[0] += 0x9E3779B9u;
+            k[1] += 0xBB67AE85u;
+        }
+        return ctr;
+    }
+
+    // Four random 32-bit words for the element 'index' of the stream 'stream'.
+    Counter operator()(std::uint64_t index, std::uint32_t stream = 0) const {
+        return (*this)(Counter {{static_cast<std::uint32_t>(index), static_cast<std::uint32_t>(index >> 32), stream, 0}});
+    }
+
+    // Uniformly distributed value from [0, 1) for the element 'index' of the stream 'stream'.
+    double uniform(std::uint64_t index, std::uint32_t stream = 0) const {
+        return toUniform((*this)(index, stream)[0]);
+    }
+
+    static double toUniform(std::uint32_t value) {
+        // Use top 24 bits so the result is exactly representable as float too.
+        return static_cast<double>(value >> 8) * (1.0 / 16777216.0);
+    }
+
+private:
+    static Counter round(const Counter &ctr, const Key &k) {
+        const auto p0 = static_cast<std::uint64_t>(0xD2511F53u) * ctr[0];
+        const auto p1 = static_cast<std::uint64_t>(0xCD9E8D57u) * ctr[2];
+        const auto hi0 = static_cast<std::uint32_t>(p0 >> 32);
+        const auto lo0 = static_cast<std::uint32_t>(p0);
+        const auto hi1 = static_cast<std::uint32_t>(p1 >> 32);
+        const auto lo1 = static_cast<std::uint32_t>(p1);
+        return Counter {{hi1 ^ ctr[1] ^ k[0], lo1, hi0 ^ ctr[3] ^ k[1], lo0}};
+    }
+
+private:
+    Key key;
+};
@@ -0,0 +1,81 @@
+#include "prepared_frame.h"
+
+#include <algorithm>
+
+namespace {
+
+bool isSameSize(const Frame3D<GLfloat> &frame1, const Frame3D<GLfloat> &frame2) {
+    return frame1.width() == frame2.width() && frame1.height() == frame2.height() && frame1.depth() == frame2.depth();
+}
+
+// Slices [z_begin, z_end) which cover the slabs of 'slab' slices where the frames differ; empty if they are equal.
+void changedSlices(const Frame3D<GLfloat> &frame1, const Frame3D<GLfloat> &frame2, size_t slab,
+                   size_t &z_begin, size_t &z_end) {
+    const auto d = frame1.depth();
+    const auto slice_size = frame1.width() * frame1.height();
+    const auto slabEquals = [&](size_t z) {
+        const auto begin = z * slice_size, end = std::min(z + slab, d) * slice_size;
+        return std::equal(frame1.data() + begin, frame1.data() + end, frame2.data() + begin);
+    };
+    z_begin = 0;
+    while (z_begin < d && slabEquals(z_begin)) {
+        z_begin += slab;
+    }
+    if (z_begin >= d) {
+        z_begin = z_end = 0;
+        return;
+    }
+    // The last slab may be partial.
+    z_end = (d - 1) / slab * slab;
+    while (z_end > z_begin && slabEquals(z_end)) {
+        z_end -= slab;
+    }
+    z_end = std::min(z_end + slab, d);
+}
+
+}
+
+PreparedFrame prepareFrame(std::shared_ptr<const Frame3D<GLfloat>> frame, const FrameOptions &options,
+                           const PreparedFrame &previous) {
+    PreparedFrame prepared;
+    prepared.frame = frame;
+    prepared.options = options;
+    const auto incremental = previous.frame && previous.options == options && previous.bricks &&
+                             (previous.pyramid || !options.pyramid) && (previous.gradient || !options.gradient) &&
+                             isSameSize(*previous.frame, *frame);
+    if (incremental) {
+        prepared.base = previous.frame;
+        changedSlices(*previous.frame, *frame, previous.bricks->brickSize(), prepared.changed_begin, prepared.changed_end);
+        const auto z_begin = prepared.changed_begin, z_end = prepared.changed_end;
+        if (z_begin == z_end) {
+            // Nothing has changed, the derived data is shared.
+            prepared.bricks = previous.bricks;
+            prepared.pyramid = previous.pyramid;
+            prepared.gradient = previous.gradient;
+            return prepared;
+        }
+        // Previous data may be still in use (e.g. uploaded), so changed slices are recomputed in copies.
+        auto bricks = std::make_shared<BrickVolume>(*previous.bricks);
+        bricks->update(*frame, z_begin, z_end);
+        prepared.bricks = bricks;
+        if (options.pyramid) {
+            auto levels = std::make_shared<FramePyramid>(*previous.pyramid);
+            updatePyramid(*frame, *levels, z_begin, z_end, options.pyramid_filter);
+            prepared.pyramid = levels;
+        }
+        if (options.gradient) {
+            auto gradient = std::make_shared<GradientFrame>(*previous.gradient);
+            updateGradient(*frame, *gradient, z_begin, z_end);
+            prepared.gradient = gradient;
+        }
+        return prepared;
+    }
+    prepared.bricks = std::make_shared<const BrickVolume>(*frame);
+    if (options.pyramid) {
+        prepared.pyramid = std::make_shared<const FramePyramid>(buildPyramid(*frame, options.pyramid_filter));
+    }
+    if (options.gradient) {
+        prepared.gradient = std::make_shared<const GradientFrame>(computeGradient(*frame));
+    }
+    return prepared;
+}
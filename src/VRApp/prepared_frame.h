@@ -0,0 +1,48 @@
+#pragma once
+
+#include "frame3d.h"
+#include "brick_volume.h"
+#include "gradient_volume.h"
+#include "volume_pyramid.h"
+
+#include <QOpenGLFunctions>
+
+#include <memory>
+
+// Settings of the viewer which determine the data derived from a frame.
+struct FrameOptions {
+    PyramidFilter pyramid_filter {PF_BOX};
+    bool pyramid {true}; // levels of detail of the data texture; a virtual texture has none
+    bool gradient {false}; // gradients for lighting
+
+    bool operator==(const FrameOptions &other) const {
+        return pyramid_filter == other.pyramid_filter && pyramid == other.pyramid && gradient == other.gradient;
+    }
+
+    bool operator!=(const FrameOptions &other) const {
+        return !(*this == other);
+    }
+};
+
+/*
+ * Frame with the data which the viewer derives from it: brick ranges, levels of detail and gradients.
+ * Computing them takes much longer than uploading, so it's done off the GUI thread together with loading.
+ */
+struct PreparedFrame {
+    std::shared_ptr<const Frame3D<GLfloat>> frame;
+    FrameOptions options;
+    std::shared_ptr<const BrickVolume> bricks;
+    std::shared_ptr<const FramePyramid> pyramid; // null unless options.pyramid
+    std::shared_ptr<const GradientFrame> gradient; // null unless options.gradient
+
+    // If not null, the frame differs from this one only in slices [changed_begin, changed_end),
+    // so textures of the base frame can be updated by these slices.
+    std::shared_ptr<const Frame3D<GLfloat>> base;
+    size_t changed_begin {0}, changed_end {0};
+};
+
+// Thread-safe: it can be called from background tasks.
+// If the previous frame has the same size and options, the frames are compared by slabs of a brick,
+// and only the data derived from the changed slabs is recomputed.
+PreparedFrame prepareFrame(std::shared_ptr<const Frame3D<GLfloat>> frame, const FrameOptions &options,
+                           const PreparedFrame &previous = PreparedFrame());
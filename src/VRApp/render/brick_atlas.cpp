@@ -0,0 +1,211 @@
+#include "brick_atlas.h"
+
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLPixelTransferOptions>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+size_t numOfBricks(size_t size, size_t brick_size) {
+    return (size + brick_size - 1) / brick_size;
+}
+
+// Page table entry: atlas slot coords (rgb) and residency (a); bytes are in memory order on little-endian hosts.
+GLuint packEntry(size_t x, size_t y, size_t z) {
+    return static_cast<GLuint>(x) | (static_cast<GLuint>(y) << 8) | (static_cast<GLuint>(z) << 16) | (0xFFu << 24);
+}
+
+}
+
+BrickAtlas::BrickAtlas(size_t brick_size) :
+    brick_size(std::max(brick_size, size_t(1)))
+{
+}
+
+size_t BrickAtlas::slotsForBudget(size_t byte_budget, size_t brick_size) {
+    const auto side = brick_size + 2;
+    const auto slots = static_cast<size_t>(std::cbrt(static_cast<double>(byte_budget / (side * side * side * sizeof(GLfloat)))));
+    return std::max(slots, size_t(1));
+}
+
+void BrickAtlas::setFrame(std::shared_ptr<const Frame3D<GLfloat>> data) {
+    frame = data;
+    frame_changed = true;
+    stale_bricks.clear();
+}
+
+void BrickAtlas::updateFrameSlab(std::shared_ptr<const Frame3D<GLfloat>> data, size_t z_begin, size_t z_end) {
+    if (!frame || frame_changed || frame->width() != data->width() || frame->height() != data->height() ||
+            frame->depth() != data->depth()) {
+        setFrame(data);
+        return;
+    }
+    frame = data;
+    // Bricks which aprons contain the changed slices are affected too.
+    const auto bz_begin = (z_begin > 0 ? z_begin - 1 : 0) / brick_size;
+    const auto bz_end = std::min((z_end + brick_size) / brick_size, page_entries.depth());
+    const auto bricks_per_slice = page_entries.width() * page_entries.height();
+    for (auto brick = bz_begin * bricks_per_slice; brick < bz_end * bricks_per_slice; brick++) {
+        if (residency.slot(brick) != BrickResidency::NOT_RESIDENT) {
+            stale_bricks.push_back(brick);
+        }
+    }
+}
+
+void BrickAtlas::setSlotsPerAxis(size_t slots) {
+    if (slots != slots_per_axis) {
+        slots_per_axis = std::max(slots, size_t(1));
+        atlas.reset();
+    }
+}
+
+void BrickAtlas::allocate() {
+    auto *gl = QOpenGLContext::currentContext()->functions();
+    GLint max_size = 0;
+    gl->glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &max_size);
+    const auto side = brick_size + 2;
+    // Slot coords are stored in bytes of page table entries.
+    atlas_slots = std::min(std::min(slots_per_axis, static_cast<size_t>(max_size) / side), size_t(255));
+    const auto size = static_cast<int>(atlas_slots * side);
+    atlas = std::make_unique<QOpenGLTexture>(QOpenGLTexture::Target3D);
+    atlas->setSize(size, size, size);
+    atlas->setFormat(QOpenGLTexture::R32F);
+    atlas->setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
+    atlas->setWrapMode(QOpenGLTexture::ClampToEdge);
+    atlas->allocateStorage();
+    // Nothing is resident in the new atlas.
+    frame_changed = true;
+}
+
+bool BrickAtlas::prepare() {
+    if (!frame) {
+        return false;
+    }
+    if (!atlas) {
+        allocate();
+    }
+    if (frame_changed) {
+        residency.reset(atlas_slots * atlas_slots * atlas_slots);
+        page_entries = Frame3D<GLuint>(numOfBricks(frame->width(), brick_size), numOfBricks(frame->height(), brick_size),
+                                       numOfBricks(frame->depth(), brick_size));
+        page_entries.fillBy(0);
+        stale_bricks.clear();
+        frame_changed = false;
+        page_table_dirty = true;
+    }
+    // Stale bricks are uploaded in place.
+    for (auto brick: stale_bricks) {
+        const auto slot = residency.slot(brick);
+        if (slot != BrickResidency::NOT_RESIDENT) {
+            uploadBrick(brick, static_cast<size_t>(slot));
+        }
+    }
+    stale_bricks.clear();
+
+    if (!page_table || page_table->width() != static_cast<int>(page_entries.width()) ||
+            page_table->height() != static_cast<int>(page_entries.height()) ||
+            page_table->depth() != static_cast<int>(page_entries.depth())) {
+        page_table = std::make_unique<QOpenGLTexture>(QOpenGLTexture::Target3D);
+        page_table->setSize(static_cast<int>(page_entries.width()), static_cast<int>(page_entries.height()),
+                            static_cast<int>(page_entries.depth()));
+        page_table->setFormat(QOpenGLTexture::RGBA8U);
+        // Integer textures can't be filtered.
+        page_table->setMinMagFilters(QOpenGLTexture::Nearest, QOpenGLTexture::Nearest);
+        page_table->setWrapMode(QOpenGLTexture::ClampToEdge);
+        page_table->allocateStorage();
+        page_table_dirty = true;
+    }
+    if (page_table_dirty) {
+        QOpenGLPixelTransferOptions options;
+        options.setAlignment(1);
+        page_table->setData(QOpenGLTexture::RGBA_Integer, QOpenGLTexture::UInt8, page_entries.data(), &options);
+        page_table_dirty = false;
+    }
+    return true;
+}
+
+size_t BrickAtlas::page(const std::vector<size_t> &used, const std::vector<size_t> &missing, size_t max_loads) {
+    if (!frame || !atlas) {
+        return 0;
+    }
+    const auto loads = residency.request(used, missing, max_loads);
+    for (const auto &load: loads) {
+        if (load.evicted) {
+            setPageEntry(load.evicted_brick, BrickResidency::NOT_RESIDENT);
+        }
+        uploadBrick(load.brick, load.slot);
+        setPageEntry(load.brick, static_cast<int>(load.slot));
+    }
+    // Page table is uploaded before the next frame.
+    return loads.size();
+}
+
+void BrickAtlas::uploadBrick(size_t brick, size_t slot) {
+    const auto bw = page_entries.width(), bh = page_entries.height();
+    const auto bx = brick % bw, by = (brick / bw) % bh, bz = brick / (bw * bh);
+    const auto side = brick_size + 2;
+    brick_data.resize(side * side * side);
+
+    // Brick with the apron; voxels out of the frame are clamped to its border, as with ClampToEdge.
+    const auto w = static_cast<long long>(frame->width());
+    const auto h = static_cast<long long>(frame->height());
+    const auto d = static_cast<long long>(frame->depth());
+    const auto x0 = static_cast<long long>(bx * brick_size) - 1;
+    const auto y0 = static_cast<long long>(by * brick_size) - 1;
+    const auto z0 = static_cast<long long>(bz * brick_size) - 1;
+    const auto *data = frame->data();
+    auto *dest = brick_data.data();
+    for (size_t k = 0; k < side; k++) {
+        const auto z = std::min(std::max(z0 + static_cast<long long>(k), 0LL), d - 1);
+        for (size_t j = 0; j < side; j++) {
+            const auto y = std::min(std::max(y0 + static_cast<long long>(j), 0LL), h - 1);
+            const auto *row = data + (z * h + y) * w;
+            for (size_t i = 0; i < side; i++) {
+                const auto x = std::min(std::max(x0 + static_cast<long long>(i), 0LL), w - 1);
+                *dest++ = row[x];
+            }
+        }
+    }
+
+    const auto sx = slot % atlas_slots, sy = (slot / atlas_slots) % atlas_slots, sz = slot / (atlas_slots * atlas_slots);
+    auto *gl = QOpenGLContext::currentContext()->extraFunctions();
+    atlas->bind();
+    gl->glTexSubImage3D(GL_TEXTURE_3D, 0, static_cast<GLint>(sx * side), static_cast<GLint>(sy * side), static_cast<GLint>(sz * side),
+                        static_cast<GLsizei>(side), static_cast<GLsizei>(side), static_cast<GLsizei>(side),
+                        GL_RED, GL_FLOAT, brick_data.data());
+    atlas->release();
+}
+
+void BrickAtlas::setPageEntry(size_t brick, int slot) {
+    auto &entry = page_entries.data()[brick];
+    if (slot == BrickResidency::NOT_RESIDENT) {
+        entry = 0;
+    } else {
+        const auto s = static_cast<size_t>(slot);
+        entry = packEntry(s % atlas_slots, (s / atlas_slots) % atlas_slots, s / (atlas_slots * atlas_slots));
+    }
+    page_table_dirty = true;
+}
+
+QVector3D BrickAtlas::volumeSize() const {
+    if (!frame) {
+        return QVector3D(1.0f, 1.0f, 1.0f);
+    }
+    return QVector3D(frame->width(), frame->height(), frame->depth());
+}
+
+QVector3D BrickAtlas::pageTableSize() const {
+    return QVector3D(page_entries.width(), page_entries.height(), page_entries.depth());
+}
+
+void BrickAtlas::release() {
+    frame.reset();
+    stale_bricks.clear();
+    residency.reset(0);
+    atlas.reset();
+    page_table.reset();
+    atlas_slots = 0;
+}
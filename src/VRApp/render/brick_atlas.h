@@ -0,0 +1,89 @@
+#pragma once
+
+#include "brick_residency.h"
+#include "frame3d.h"
+
+#include <QOpenGLTexture>
+#include <QVector3D>
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/*
+ * Virtual 3D texture for volumes which don't fit GPU memory: bricks of the frame are paged into
+ * a fixed-size atlas texture on demand. Page table has an entry per brick with its atlas slot (rgb)
+ * and residency (a). Bricks are stored with a one-voxel apron, so trilinear filtering inside a brick
+ * doesn't need its neighbours. Bricks to page in are reported by the renderer (see BrickResidency).
+ * Methods which touch GL objects (prepare, page, release) should be called with the GL context current.
+ */
+class BrickAtlas {
+public:
+    explicit BrickAtlas(size_t brick_size = 32);
+    ~BrickAtlas() = default;
+
+    // Slots per axis of an atlas which fits the byte budget.
+    static size_t slotsForBudget(size_t byte_budget, size_t brick_size = 32);
+
+    // All bricks of the previous frame are evicted.
+    void setFrame(std::shared_ptr<const Frame3D<GLfloat>> frame);
+
+    // Frame should be of the same size as the previous one; resident bricks of slices [z_begin, z_end) are uploaded again.
+    void updateFrameSlab(std::shared_ptr<const Frame3D<GLfloat>> frame, size_t z_begin, size_t z_end);
+
+    // Atlas has slots^3 bricks (limited by the max 3D texture size); it's reallocated on the next prepare().
+    void setSlotsPerAxis(size_t slots);
+
+    // Allocate textures and apply pending changes before rendering. Returns false if there is no frame.
+    bool prepare();
+
+    // Page in missing bricks (at most max_loads), keeping used ones; bricks are indices into the page table.
+    // Returns the number of loaded bricks.
+    size_t page(const std::vector<size_t> &used, const std::vector<size_t> &missing, size_t max_loads = 64);
+
+    QOpenGLTexture* texture() const {
+        return atlas.get();
+    }
+
+    QOpenGLTexture* pageTable() const {
+        return page_table.get();
+    }
+
+    size_t brickSize() const {
+        return brick_size;
+    }
+
+    // Size of the frame in voxels.
+    QVector3D volumeSize() const;
+
+    // Size of the page table (number of bricks along each axis).
+    QVector3D pageTableSize() const;
+
+    size_t numOfResident() const {
+        return residency.numOfResident();
+    }
+
+    // Drop the frame and free GL objects.
+    void release();
+
+private:
+    void allocate();
+    void uploadBrick(size_t brick, size_t slot);
+    void setPageEntry(size_t brick, int slot);
+
+private:
+    size_t brick_size;
+    size_t slots_per_axis {8};
+    size_t atlas_slots {0}; // slots per axis of the allocated atlas
+
+    std::shared_ptr<const Frame3D<GLfloat>> frame;
+    std::vector<size_t> stale_bricks; // resident bricks which data has changed
+    bool frame_changed {false};
+
+    BrickResidency residency;
+    Frame3D<GLuint> page_entries {1, 1, 1};
+    bool page_table_dirty {false};
+    std::vector<GLfloat> brick_data;
+
+    std::unique_ptr<QOpenGLTexture> atlas, page_table;
+};
@@ -0,0 +1,412 @@
+#include "cpu_ray_cast_renderer.h"
+#include "frame_profiler.h"
+#include "frame_util.h"
+
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QVector4D>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+namespace {
+
+const int tile_size = 16;
+const int packet_size = 8; // neighbouring pixels of a tile row
+
+// Linearly filtered lookup into a 2D RGBA table at a position in [0, 1], like a texture lookup with clamping to edge.
+QVector4D lookupRGBA(const std::vector<GLfloat> &table, int width, int height, float s, float t) {
+    const auto u = std::min(std::max(s * static_cast<float>(width) - 0.5f, 0.0f), static_cast<float>(width - 1));
+    const auto v = std::min(std::max(t * static_cast<float>(height) - 0.5f, 0.0f), static_cast<float>(height - 1));
+    const auto x0 = static_cast<int>(u), y0 = static_cast<int>(v);
+    const auto x1 = std::min(x0 + 1, width - 1), y1 = std::min(y0 + 1, height - 1);
+    const auto texel = [&table, width](int x, int y) {
+        const auto *p = &table[static_cast<size_t>(y * width + x) * 4];
+        return QVector4D(p[0], p[1], p[2], p[3]);
+    };
+    const auto tx = u - static_cast<float>(x0), ty = v - static_cast<float>(y0);
+    const auto c0 = texel(x0, y0) + (texel(x1, y0) - texel(x0, y0)) * tx;
+    const auto c1 = texel(x0, y1) + (texel(x1, y1) - texel(x0, y1)) * tx;
+    return c0 + (c1 - c0) * ty;
+}
+
+// Distance along the ray from the position to the exit from its brick of the given size.
+float brickExitDistance(const QVector3D &pos, const QVector3D &dir, const QVector3D &size) {
+    auto result = std::numeric_limits<float>::max();
+    for (int k = 0; k < 3; k++) {
+        const auto brick_min = std::floor(pos[k] / size[k]) * size[k];
+        const auto exit_plane = brick_min + (dir[k] > 0.0f ? size[k] : 0.0f);
+        result = std::min(result, std::abs(exit_plane - pos[k]) / std::max(std::abs(dir[k]), 1e-6f));
+    }
+    return result;
+}
+
+// Normal at a position in texture coordinates from gradients filtered like an RGBA8 texture (see gradient_volume.h),
+// like normal() of raycast.frag: zero where the value is uniform, so the sample isn't lit.
+QVector3D sampleNormal(const GradientFrame &gradient, const QVector3D &pos) {
+    const size_t sizes[3] = {gradient.width(), gradient.height(), gradient.depth()};
+    size_t i0[3], i1[3];
+    float t[3];
+    for (int k = 0; k < 3; k++) {
+        const auto n = static_cast<float>(sizes[k]);
+        const auto u = std::min(std::max(pos[k] * n - 0.5f, 0.0f), n - 1.0f);
+        i0[k] = static_cast<size_t>(u);
+        i1[k] = std::min(i0[k] + 1, sizes[k] - 1);
+        t[k] = u - static_cast<float>(i0[k]);
+    }
+    const auto texel = [&gradient](size_t x, size_t y, size_t z) {
+        const auto packed = gradient.at(x, y, z);
+        return QVector4D(packed & 0xffu, (packed >> 8) & 0xffu, (packed >> 16) & 0xffu, packed >> 24) / 255.0f;
+    };
+    const auto c00 = texel(i0[0], i0[1], i0[2]) + (texel(i1[0], i0[1], i0[2]) - texel(i0[0], i0[1], i0[2])) * t[0];
+    const auto c10 = texel(i0[0], i1[1], i0[2]) + (texel(i1[0], i1[1], i0[2]) - texel(i0[0], i1[1], i0[2])) * t[0];
+    const auto c01 = texel(i0[0], i0[1], i1[2]) + (texel(i1[0], i0[1], i1[2]) - texel(i0[0], i0[1], i1[2])) * t[0];
+    const auto c11 = texel(i0[0], i1[1], i1[2]) + (texel(i1[0], i1[1], i1[2]) - texel(i0[0], i1[1], i1[2])) * t[0];
+    const auto c0 = c00 + (c10 - c00) * t[1];
+    const auto c1 = c01 + (c11 - c01) * t[1];
+    const auto value = c0 + (c1 - c0) * t[2];
+    if (value.w() < 0.5f / 255.0f) {
+        return QVector3D();
+    }
+    const auto N = value.toVector3D() * 2.0f - QVector3D(1.0f, 1.0f, 1.0f);
+    return N / std::max(N.length(), 1e-4f);
+}
+
+QVector3D shade(const QVector3D &N, const QVector3D &V, const QVector3D &L) {
+    // Material and light of raycast.frag.
+    const auto diffuse_coeff = 0.6f;
+    const auto specular_coeff = 0.2f;
+    const auto shininess = 100.0f;
+    const auto H = (L + V).normalized();
+    const auto diffuse_light = std::max(QVector3D::dotProduct(L, N), 0.0f);
+    auto result = QVector3D(1.0f, 1.0f, 1.0f) * diffuse_coeff * diffuse_light;
+    if (diffuse_light > 0.0f) {
+        result += QVector3D(1.0f, 1.0f, 1.0f) * specular_coeff * std::pow(std::max(QVector3D::dotProduct(H, N), 0.0f), shininess);
+    }
+    return result;
+}
+
+}
+
+void CpuRayCastRenderer::doInit(QOpenGLFunctions *gl) {
+    program = loadProgram("shaders/image.vert", "shaders/image.frag");
+
+    // Quad over the whole viewport, drawn as a triangle strip.
+    static const GLfloat quad[] = {-1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f};
+    quad_vao = std::make_unique<QOpenGLVertexArrayObject>();
+    quad_vao->create();
+    quad_vao->bind();
+    quad_buffer = std::make_unique<QOpenGLBuffer>(QOpenGLBuffer::VertexBuffer);
+    quad_buffer->create();
+    quad_buffer->bind();
+    quad_buffer->allocate(quad, sizeof(quad));
+    const auto vertex_loc = program->attributeLocation("vertex");
+    program->enableAttributeArray(vertex_loc);
+    program->setAttributeBuffer(vertex_loc, GL_FLOAT, 0, 2);
+    quad_vao->release();
+    quad_buffer->release();
+
+    // Own jitter pattern: the one of the jitter texture is not kept in host memory.
+    std::random_device rd;
+    std::mt19937 mt(rd());
+    std::uniform_real_distribution<GLfloat> dist(0.0f, 1.0f);
+    jitter_values.resize(static_cast<size_t>(jitter_size * jitter_size));
+    for (auto &value: jitter_values) {
+        value = dist(mt);
+    }
+
+    gl->glDisable(GL_DEPTH_TEST);
+    gl->glDisable(GL_CULL_FACE);
+    gl->glEnable(GL_BLEND);
+    gl->glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+QVector3D CpuRayCastRenderer::volumeSize() const {
+    if (!frame) {
+        return Renderer::volumeSize();
+    }
+    return QVector3D(frame->width(), frame->height(), frame->depth());
+}
+
+int CpuRayCastRenderer::levelCount() const {
+    return static_cast<int>(pyramid ? pyramid->size() : 0) + 1;
+}
+
+GLfloat CpuRayCastRenderer::sampleValue(const QVector3D &pos) const {
+    const auto &finer = (level == 0 ? *frame : (*pyramid)[static_cast<size_t>(level - 1)]);
+    auto value = sampleTrilinear(finer, pos.x(), pos.y(), pos.z());
+    if (level_weight > 0.0f) {
+        const auto next = sampleTrilinear((*pyramid)[static_cast<size_t>(level)], pos.x(), pos.y(), pos.z());
+        value += (next - value) * level_weight;
+    }
+    return value;
+}
+
+void CpuRayCastRenderer::sampleValues(const float *x, const float *y, const float *z, GLfloat *values, int count) const {
+    const auto &finer = (level == 0 ? *frame : (*pyramid)[static_cast<size_t>(level - 1)]);
+    sampleTrilinear(finer, x, y, z, values, static_cast<size_t>(count));
+    if (level_weight > 0.0f) {
+        GLfloat next[packet_size];
+        sampleTrilinear((*pyramid)[static_cast<size_t>(level)], x, y, z, next, static_cast<size_t>(count));
+        for (int l = 0; l < count; l++) {
+            values[l] += (next[l] - values[l]) * level_weight;
+        }
+    }
+}
+
+QVector3D CpuRayCastRenderer::gradient(const QVector3D &pos) const {
+    if (gradient_frame) {
+        return sampleNormal(*gradient_frame, pos);
+    }
+    const auto delta = 0.01f;
+    const QVector3D dx(delta, 0.0f, 0.0f), dy(0.0f, delta, 0.0f), dz(0.0f, 0.0f, delta);
+    const QVector3D sample1(sampleValue(pos - dx), sampleValue(pos - dy), sampleValue(pos - dz));
+    const QVector3D sample2(sampleValue(pos + dx), sampleValue(pos + dy), sampleValue(pos + dz));
+    return (sample2 - sample1).normalized();
+}
+
+float CpuRayCastRenderer::brickStepScale(const QVector3D &pos) const {
+    const auto brick = [&pos, this](int k, size_t size) {
+        return static_cast<size_t>(std::min(std::max(static_cast<int>(pos[k] / brick_extent[k]), 0), static_cast<int>(size) - 1));
+    };
+    const auto &occupancy = *occupancy_values;
+    return occupancy.at(brick(0, occupancy.width()), brick(1, occupancy.height()), brick(2, occupancy.depth()));
+}
+
+void CpuRayCastRenderer::castPacket(int x, int y, int count) {
+    // Rays of the packet march in lockstep, so their samples are taken together; a ray drops out when it's done.
+    QVector3D dir[packet_size];
+    QVector4D dest[packet_size];
+    float pos_x[packet_size], pos_y[packet_size], pos_z[packet_size];
+    float dist[packet_size], exit[packet_size], scale[packet_size];
+    GLfloat values[packet_size], prev_values[packet_size];
+    bool active[packet_size], skipped[packet_size];
+
+    const auto set_position = [&](int l) {
+        const auto pos = eye + dir[l] * dist[l];
+        pos_x[l] = pos.x();
+        pos_y[l] = pos.y();
+        pos_z[l] = pos.z();
+    };
+
+    const auto ndc_y = (static_cast<float>(y) + 0.5f) / static_cast<float>(image_height) * 2.0f - 1.0f;
+    for (int l = 0; l < count; l++) {
+        // Ray through the pixel center; texture coordinates are scaled object ones, so the direction is the same.
+        const auto ndc_x = (static_cast<float>(x + l) + 0.5f) / static_cast<float>(image_width) * 2.0f - 1.0f;
+        const auto far_point = (pixel_to_object * QVector4D(ndc_x, ndc_y, 1.0f, 1.0f)).toVector3DAffine();
+        dir[l] = (far_point - eye_object).normalized();
+
+        // Slab test against the proxy box; the pixel is covered if the ray leaves the box in front of the eye.
+        QVector3D t_near, t_far;
+        for (int k = 0; k < 3; k++) {
+            const auto inv_dir = 1.0f / dir[l][k];
+            const auto t0 = (box_min[k] - eye[k]) * inv_dir;
+            const auto t1 = (box_max[k] - eye[k]) * inv_dir;
+            t_near[k] = std::min(t0, t1);
+            t_far[k] = std::max(t0, t1);
+        }
+        const auto span_entry = std::max(t_near.x(), std::max(t_near.y(), t_near.z()));
+        const auto span_exit = std::min(t_far.x(), std::min(t_far.y(), t_far.z()));
+        auto entry = std::max(span_entry, 0.0f);
+        active[l] = (span_exit > entry);
+        exit[l] = std::max(span_exit, entry);
+
+        if (jitter_enabled) {
+            entry += step * jitter_values[static_cast<size_t>((y % jitter_size) * jitter_size + (x + l) % jitter_size)];
+        }
+        dist[l] = entry;
+        dest[l] = QVector4D();
+        set_position(l);
+    }
+
+    const auto preintegrated = preintegration_enabled && !preintegration_values.empty();
+    const auto zero_inactive = [&]() {
+        // Positions of dropped out rays are still sampled, so they're kept valid.
+        for (int l = 0; l < count; l++) {
+            if (!active[l]) {
+                pos_x[l] = pos_y[l] = pos_z[l] = 0.0f;
+            }
+        }
+    };
+    zero_inactive();
+    if (preintegrated) {
+        sampleValues(pos_x, pos_y, pos_z, prev_values, count);
+    }
+
+    for (int i = 0; i < num_steps; i++) {
+        auto any_active = false;
+        for (int l = 0; l < count; l++) {
+            active[l] = active[l] && dist[l] < exit[l];
+            any_active = any_active || active[l];
+        }
+        if (!any_active) {
+            break;
+        }
+
+        for (int l = 0; l < count; l++) {
+            scale[l] = 1.0f; // length of the current step in base steps
+            skipped[l] = false;
+            if (!active[l] || !skipping) {
+                continue;
+            }
+            const QVector3D pos(pos_x[l], pos_y[l], pos_z[l]);
+            const auto brick_scale = brickStepScale(pos);
+            const auto exit_distance = brickExitDistance(pos, dir[l], brick_extent);
+            if (brick_scale == 0.0f) {
+                // Leap to the first sample behind the empty brick.
+                dist[l] += step * std::max(std::ceil(exit_distance / step), 1.0f);
+                set_position(l);
+                skipped[l] = true;
+            } else {
+                // Long steps in homogeneous bricks, but not beyond the brick exit.
+                scale[l] = std::min(std::max(std::floor(exit_distance / step), 1.0f), brick_scale);
+            }
+        }
+
+        zero_inactive();
+        sampleValues(pos_x, pos_y, pos_z, values, count);
+
+        for (int l = 0; l < count; l++) {
+            if (!active[l]) {
+                continue;
+            }
+            if (skipped[l]) {
+                prev_values[l] = values[l]; // sample behind the empty brick starts the next segment
+                continue;
+            }
+
+            QVector4D classified;
+            if (preintegrated) {
+                // Map values onto texel centers of the table, like getSegment() of the shader.
+                const auto n = static_cast<float>(preintegration_size);
+                const auto segment = lookupRGBA(preintegration_values, preintegration_size, preintegration_size,
+                                                 (prev_values[l] * (n - 1.0f) + 0.5f) / n, (values[l] * (n - 1.0f) + 0.5f) / n);
+                prev_values[l] = values[l];
+                classified = QVector4D(segment.toVector3D() / std::max(segment.w(), 1e-6f), segment.w());
+            } else {
+                classified = lookupRGBA(lut_values, lut_size, 1, values[l], 0.5f);
+            }
+
+            const auto alpha = 1.0f - std::pow(std::max(1.0f - classified.w(), 0.0f), step_coeff * scale[l]);
+            if (alpha > 0.0f) {
+                auto color = classified.toVector3D();
+                if (lighting_enabled && alpha > 0.05f) {
+                    const QVector3D pos(pos_x[l], pos_y[l], pos_z[l]);
+                    const auto coord = pos * 2.0f - QVector3D(1.0f, 1.0f, 1.0f);
+                    color += shade(gradient(pos), -dir[l], (light_object - coord).normalized());
+                }
+                // Front-to-back compositing.
+                dest[l] = (1.0f - dest[l].w()) * QVector4D(color * alpha, alpha) + dest[l];
+            }
+
+            // Early termination by alpha.
+            if (dest[l].w() > 0.99f) {
+                active[l] = false;
+                continue;
+            }
+            dist[l] += step * scale[l];
+            set_position(l);
+        }
+    }
+
+    auto *out = &image[static_cast<size_t>(y * image_width + x) * 4];
+    for (int l = 0; l < count; l++) {
+        out[l * 4 + 0] = dest[l].x();
+        out[l * 4 + 1] = dest[l].y();
+        out[l * 4 + 2] = dest[l].z();
+        out[l * 4 + 3] = dest[l].w();
+    }
+}
+
+void CpuRayCastRenderer::doRender(QOpenGLFunctions *gl) {
+    if (!frame || lut_values.empty() || !visibleBox(box_min, box_max)) {
+        return;
+    }
+    GLint viewport[4];
+    gl->glGetIntegerv(GL_VIEWPORT, viewport);
+    image_width = viewport[2];
+    image_height = viewport[3];
+    if (image_width <= 0 || image_height <= 0) {
+        return;
+    }
+
+    // The same state as the uniforms of the shader ray caster.
+    const auto &state = frame_uniforms.data();
+    eye_object = QVector3D(state.eye_position[0], state.eye_position[1], state.eye_position[2]);
+    light_object = QVector3D(state.light_position[0], state.light_position[1], state.light_position[2]);
+    eye = (eye_object + QVector3D(1.0f, 1.0f, 1.0f)) * 0.5f;
+    step_coeff = state.step_mult_coeff;
+    num_steps = state.num_steps;
+    pixel_to_object = (projection_matrix * view_matrix * model_matrix).inverted();
+    skipping = skippingEnabled();
+    if (skipping) {
+        const auto brick_size = static_cast<float>(brick_volume->brickSize());
+        brick_extent = QVector3D(brick_size, brick_size, brick_size) / volumeSize();
+    }
+    // Level of detail blends two mip levels, like a texture with linear mipmap filtering.
+    const auto max_level = static_cast<int>(pyramid ? pyramid->size() : 0);
+    level = std::min(static_cast<int>(std::floor(lod)), max_level);
+    level_weight = (level < max_level ? lod - static_cast<float>(level) : 0.0f);
+
+    image.resize(static_cast<size_t>(image_width * image_height) * 4);
+    const auto tiles_x = (image_width + tile_size - 1) / tile_size;
+    const auto tiles_y = (image_height + tile_size - 1) / tile_size;
+    // Cost of tiles varies a lot (empty space, early termination), so threads take them one at a time.
+    #pragma omp parallel for schedule(dynamic)
+    for (int tile = 0; tile < tiles_x * tiles_y; tile++) {
+        const auto x_begin = (tile % tiles_x) * tile_size;
+        const auto y_begin = (tile / tiles_x) * tile_size;
+        const auto x_end = std::min(x_begin + tile_size, image_width);
+        const auto y_end = std::min(y_begin + tile_size, image_height);
+        for (int y = y_begin; y < y_end; y++) {
+            for (int x = x_begin; x < x_end; x += packet_size) {
+                castPacket(x, y, std::min(packet_size, x_end - x));
+            }
+        }
+    }
+
+    if (!image_texture || image_texture->width() != image_width || image_texture->height() != image_height) {
+        image_texture = std::make_unique<QOpenGLTexture>(QOpenGLTexture::Target2D);
+        image_texture->setSize(image_width, image_height);
+        image_texture->setMinMagFilters(QOpenGLTexture::Nearest, QOpenGLTexture::Nearest);
+        image_texture->setWrapMode(QOpenGLTexture::ClampToEdge);
+        image_texture->setFormat(QOpenGLTexture::RGBA32F);
+        image_texture->allocateStorage();
+    }
+    image_texture->setData(QOpenGLTexture::RGBA, QOpenGLTexture::Float32, image.data());
+
+    gl->glActiveTexture(GL_TEXTURE0);
+    image_texture->bind();
+    quad_vao->bind();
+    gl->glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    quad_vao->release();
+    image_texture->release();
+}
+
+void CpuRayCastRenderer::render(QOpenGLFunctions *gl) {
+    if (!program || !frame || transfer_function.isEmpty()) {
+        return;
+    }
+    // The whole frame is in host memory, so bricks are never paged in.
+    virtual_enabled = false;
+    paging = false;
+
+    GLint viewport[4];
+    gl->glGetIntegerv(GL_VIEWPORT, viewport);
+    updateLevelOfDetail(viewport[3]);
+
+    if (profiler) {
+        profiler->begin(FrameProfiler::RENDER);
+    }
+    updateTables();
+    updateUniforms(skippingEnabled());
+
+    program->bind();
+    doRender(gl);
+    program->release();
+
+    if (profiler) {
+        profiler->end(FrameProfiler::RENDER);
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "renderer.h"
+#include "frame3d.h"
+#include "gradient_volume.h"
+#include "volume_pyramid.h"
+
+#include <QOpenGLBuffer>
+#include <QOpenGLTexture>
+#include <QOpenGLVertexArrayObject>
+#include <QVector3D>
+
+#include <memory>
+#include <vector>
+
+/*
+ * Ray caster which runs on the CPU, for machines where GL is software and the ray casting shader is slow.
+ * Rays follow raycast.frag step by step (mip level sampling, lookup tables, empty space skipping, lighting,
+ * front-to-back compositing with early termination), so the image matches the GL one and can serve as a reference.
+ * The image is cast in tiles shared dynamically by OpenMP threads; rays of a tile go in packets of neighbouring
+ * pixels which sample the frame together. It's drawn as a viewport quad with the blending of the shader ray caster.
+ * The frame is sampled in host memory, so neither the data texture nor virtual texturing is needed; lookup tables
+ * and occupancy are the host copies of the base class, which aren't uploaded. Extra channels are not rendered.
+ * Normals for lighting are decoded from precomputed gradients as the shader does with a gradient texture,
+ * or computed on the fly like in the shader without one.
+ */
+class CpuRayCastRenderer : public Renderer {
+public:
+    CpuRayCastRenderer() {
+        upload_tables = false;
+    }
+    ~CpuRayCastRenderer() override = default;
+
+    // Casts the image and draws it; volume textures, uniform blocks and the feedback pass are not used.
+    void render(QOpenGLFunctions *gl) override;
+
+    // Frame to cast rays through, with its coarser levels for the level of detail (null if there are none).
+    void setFrame(std::shared_ptr<const Frame3D<GLfloat>> data, std::shared_ptr<const FramePyramid> levels) {
+        frame = data;
+        pyramid = levels;
+    }
+
+    // Precomputed gradients of the frame for lighting; null means they're computed on the fly.
+    void setGradient(std::shared_ptr<const GradientFrame> gradient) {
+        gradient_frame = gradient;
+    }
+
+protected:
+    void doInit(QOpenGLFunctions *gl) override;
+    void doRender(QOpenGLFunctions *gl) override;
+    QVector3D volumeSize() const override;
+    int levelCount() const override;
+
+private:
+    // Cast rays of pixels [x, x + count) of row y into the image.
+    void castPacket(int x, int y, int count);
+    // Value at a position in texture coordinates at the current level of detail, like getValue() of the shader.
+    GLfloat sampleValue(const QVector3D &pos) const;
+    // Values of a packet at once.
+    void sampleValues(const float *x, const float *y, const float *z, GLfloat *values, int count) const;
+    QVector3D gradient(const QVector3D &pos) const;
+    float brickStepScale(const QVector3D &pos) const;
+
+private:
+    std::shared_ptr<const Frame3D<GLfloat>> frame;
+    std::shared_ptr<const FramePyramid> pyramid;
+    std::shared_ptr<const GradientFrame> gradient_frame;
+
+    std::vector<GLfloat> jitter_values;
+
+    // State of the current render, in texture coordinates.
+    int image_width {0}, image_height {0};
+    QMatrix4x4 pixel_to_object; // from normalized device coordinates
+    QVector3D eye, eye_object, light_object;
+    QVector3D box_min, box_max;
+    QVector3D brick_extent;
+    int level {0}; // finer mip level to sample, blended with the next one by level_weight
+    float level_weight {0.0f};
+    float step_coeff {1.0f};
+    int num_steps {0};
+    bool skipping = false;
+
+    std::vector<GLfloat> image; // RGBA, rows from the bottom like in GL
+    std::unique_ptr<QOpenGLTexture> image_texture;
+    std::unique_ptr<QOpenGLVertexArrayObject> quad_vao;
+    std::unique_ptr<QOpenGLBuffer> quad_buffer;
+};
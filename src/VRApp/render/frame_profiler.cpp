@@ -0,0 +1,236 @@
+#include "frame_profiler.h"
+
+#include <QFile>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QStringList>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+void RollingStats::add(double value) {
+    values.push_back(value);
+    if (values.size() > window) {
+        values.pop_front();
+    }
+}
+
+double RollingStats::mean() const {
+    if (values.empty()) {
+        return 0.0;
+    }
+    return std::accumulate(values.begin(), values.end(), 0.0) / static_cast<double>(values.size());
+}
+
+double RollingStats::percentile95() const {
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::vector<double> sorted(values.begin(), values.end());
+    const auto rank = static_cast<size_t>(std::ceil(0.95 * static_cast<double>(sorted.size()))) - 1;
+    std::nth_element(sorted.begin(), sorted.begin() + static_cast<std::ptrdiff_t>(rank), sorted.end());
+    return sorted[rank];
+}
+
+double RollingStats::max() const {
+    if (values.empty()) {
+        return 0.0;
+    }
+    return *std::max_element(values.begin(), values.end());
+}
+
+FrameProfiler::FrameProfiler() {
+    cpu_start.fill(0);
+    cpu_depth.fill(0);
+    cpu_ms.fill(0.0);
+    timer.start();
+}
+
+const char *FrameProfiler::sectionName(Section section) {
+    static const char *names[SECTION_COUNT] = {"paint", "render", "upload", "palette", "set_frame"};
+    return names[section];
+}
+
+void FrameProfiler::init() {
+    auto *context = QOpenGLContext::currentContext();
+    if (!context) {
+        return;
+    }
+    // Timestamps are core since GL 3.3; software rasterizers run on the CPU, so its timer is as good.
+    const auto renderer = QString::fromLatin1(reinterpret_cast<const char *>(context->functions()->glGetString(GL_RENDERER)));
+    const auto software = renderer.contains("llvmpipe", Qt::CaseInsensitive) || renderer.contains("softpipe", Qt::CaseInsensitive) ||
+                          renderer.contains("software", Qt::CaseInsensitive);
+    const auto version = context->format().version();
+    const auto has_queries = (version >= qMakePair(3, 3) || context->hasExtension("GL_ARB_timer_query"));
+    gpu_supported = has_queries && !software;
+}
+
+FrameProfiler::QueryPtr FrameProfiler::acquireQuery() {
+    if (!free_queries.empty()) {
+        auto query = free_queries.back();
+        free_queries.pop_back();
+        return query;
+    }
+    auto query = std::make_shared<QOpenGLTimerQuery>();
+    if (!query->create()) {
+        gpu_supported = false;
+        return nullptr;
+    }
+    return query;
+}
+
+void FrameProfiler::begin(Section section, bool gpu) {
+    if (cpu_depth[section]++ > 0) {
+        return;
+    }
+    cpu_start[section] = timer.nsecsElapsed();
+    if (gpu && gpu_supported && QOpenGLContext::currentContext()) {
+        gpu_start[section] = acquireQuery();
+        if (gpu_start[section]) {
+            gpu_start[section]->recordTimestamp();
+        }
+    }
+}
+
+void FrameProfiler::end(Section section, bool gpu) {
+    if (cpu_depth[section] == 0 || --cpu_depth[section] > 0) {
+        return;
+    }
+    cpu_ms[section] += static_cast<double>(timer.nsecsElapsed() - cpu_start[section]) * 1e-6;
+    if (gpu && gpu_start[section]) {
+        auto end_query = acquireQuery();
+        if (end_query) {
+            end_query->recordTimestamp();
+            intervals.push_back(Interval {section, gpu_start[section], end_query});
+        }
+        gpu_start[section].reset();
+    }
+}
+
+void FrameProfiler::beginFrame() {
+    collectGpuResults();
+    in_frame = true;
+}
+
+void FrameProfiler::endFrame(const QString &state) {
+    if (!in_frame) {
+        return;
+    }
+    in_frame = false;
+
+    Record record;
+    record.index = frame_index;
+    record.state = state;
+    record.cpu_ms = cpu_ms;
+    record.gpu_ms.fill(-1.0);
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        // Sections which haven't run in the frame don't dilute the stats.
+        if (cpu_ms[static_cast<size_t>(i)] > 0.0) {
+            cpu_stats[static_cast<size_t>(i)].add(cpu_ms[static_cast<size_t>(i)]);
+        }
+    }
+    records.push_back(record);
+    if (records.size() > max_records) {
+        records.pop_front();
+    }
+    cpu_ms.fill(0.0);
+
+    if (!intervals.empty()) {
+        pending.push_back(PendingFrame {frame_index, std::move(intervals)});
+        intervals.clear();
+    }
+    frame_index++;
+}
+
+FrameProfiler::Record *FrameProfiler::findRecord(size_t index) {
+    if (records.empty() || index < records.front().index) {
+        return nullptr;
+    }
+    const auto offset = index - records.front().index;
+    return (offset < records.size() ? &records[offset] : nullptr);
+}
+
+void FrameProfiler::collectGpuResults() {
+    // Frames complete in order, so the first one which isn't ready stops the collection.
+    while (!pending.empty()) {
+        auto &frame = pending.front();
+        const auto ready = std::all_of(frame.intervals.begin(), frame.intervals.end(), [](const Interval &interval) {
+            return interval.end->isResultAvailable();
+        });
+        if (!ready) {
+            break;
+        }
+        std::array<double, SECTION_COUNT> gpu_ms;
+        gpu_ms.fill(0.0);
+        for (auto &interval: frame.intervals) {
+            const auto start = interval.start->waitForResult();
+            const auto end = interval.end->waitForResult();
+            gpu_ms[interval.section] += static_cast<double>(end - start) * 1e-6;
+            free_queries.push_back(interval.start);
+            free_queries.push_back(interval.end);
+        }
+        auto *record = findRecord(frame.index);
+        for (size_t i = 0; i < gpu_ms.size(); i++) {
+            if (gpu_ms[i] > 0.0) {
+                gpu_stats[i].add(gpu_ms[i]);
+                if (record) {
+                    record->gpu_ms[i] = gpu_ms[i];
+                }
+            }
+        }
+        pending.pop_front();
+    }
+}
+
+QString FrameProfiler::summary() const {
+    QStringList parts;
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        const auto section = static_cast<Section>(i);
+        const auto &stats = (gpu_supported && !gpu_stats[section].isEmpty() ? gpu_stats[section] : cpu_stats[section]);
+        if (stats.isEmpty()) {
+            continue;
+        }
+        parts << QString("%0 %1/%2/%3").arg(sectionName(section))
+                 .arg(stats.mean(), 0, 'f', 2).arg(stats.percentile95(), 0, 'f', 2).arg(stats.max(), 0, 'f', 2);
+    }
+    if (parts.isEmpty()) {
+        return QString();
+    }
+    return QString("%0 ms (mean/p95/max): ").arg(gpu_supported ? "GPU" : "CPU") + parts.join(", ");
+}
+
+void FrameProfiler::saveCsv(const QString &file_name) const {
+    QFile file(file_name);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        throw std::runtime_error("Failed to open " + file_name.toStdString() + " for writing");
+    }
+    QTextStream out(&file);
+    out << "frame";
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        const auto name = sectionName(static_cast<Section>(i));
+        out << "," << name << "_cpu_ms," << name << "_gpu_ms";
+    }
+    out << ",state\n";
+    for (const auto &record: records) {
+        out << record.index;
+        for (size_t i = 0; i < record.cpu_ms.size(); i++) {
+            out << "," << record.cpu_ms[i] << ",";
+            if (record.gpu_ms[i] >= 0.0) {
+                out << record.gpu_ms[i];
+            }
+        }
+        out << ",\"" << record.state << "\"\n";
+    }
+    if (out.status() != QTextStream::Ok) {
+        throw std::runtime_error("Failed to write " + file_name.toStdString());
+    }
+}
+
+void FrameProfiler::release() {
+    pending.clear();
+    intervals.clear();
+    free_queries.clear();
+    gpu_start.fill(nullptr);
+}
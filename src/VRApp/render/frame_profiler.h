@@ -0,0 +1,134 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QOpenGLTimerQuery>
+#include <QString>
+
+#include <array>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <vector>
+
+/*
+ * Mean, 95th percentile and max over a window of the latest samples.
+ */
+class RollingStats {
+public:
+    explicit RollingStats(size_t window = 120) :
+        window(window)
+    {
+    }
+
+    void add(double value);
+
+    bool isEmpty() const {
+        return values.empty();
+    }
+
+    double mean() const;
+    double percentile95() const;
+    double max() const;
+
+private:
+    size_t window;
+    std::deque<double> values;
+};
+
+/*
+ * Times sections of painted frames: on the CPU with an elapsed timer, and on the GPU with timestamp queries.
+ * GPU results arrive a few frames later and are collected without waiting, so the profiler doesn't stall the pipeline.
+ * Under software GL (or without timer queries) only CPU times are recorded, they are the GPU work too.
+ * Sections may repeat or nest within a frame; their times are summed. Sections outside of a frame
+ * (e.g. setting a frame) go into the next one. GPU timing needs the GL context current.
+ */
+class FrameProfiler {
+public:
+    enum Section {
+        PAINT,
+        RENDER,
+        UPLOAD,
+        PALETTE,
+        SET_FRAME,
+        SECTION_COUNT
+    };
+
+    // Times of a frame, in milliseconds; GPU time is negative if unknown.
+    struct Record {
+        size_t index;
+        QString state; // settings which the frame has been rendered with
+        std::array<double, SECTION_COUNT> cpu_ms;
+        std::array<double, SECTION_COUNT> gpu_ms;
+    };
+
+    FrameProfiler();
+    ~FrameProfiler() = default;
+
+    static const char *sectionName(Section section);
+
+    // Call with the GL context current, before the first frame.
+    void init();
+
+    void beginFrame();
+    void endFrame(const QString &state);
+
+    void begin(Section section, bool gpu = true);
+    void end(Section section, bool gpu = true);
+
+    bool isGpuTimed() const {
+        return gpu_supported;
+    }
+
+    const RollingStats &cpuStats(Section section) const {
+        return cpu_stats[section];
+    }
+
+    const RollingStats &gpuStats(Section section) const {
+        return gpu_stats[section];
+    }
+
+    // Summary of the rolling stats for a status bar.
+    QString summary() const;
+
+    // Records of the latest frames as CSV; throws on failure.
+    void saveCsv(const QString &file_name) const;
+
+    // Free GL objects, with the GL context current.
+    void release();
+
+private:
+    using QueryPtr = std::shared_ptr<QOpenGLTimerQuery>;
+
+    struct Interval {
+        Section section;
+        QueryPtr start, end;
+    };
+
+    // GPU intervals of a frame which results haven't arrived yet.
+    struct PendingFrame {
+        size_t index;
+        std::vector<Interval> intervals;
+    };
+
+    QueryPtr acquireQuery();
+    void collectGpuResults();
+    Record *findRecord(size_t index);
+
+    bool gpu_supported = false;
+    bool in_frame = false;
+    size_t frame_index = 0;
+    size_t max_records = 10000;
+
+    QElapsedTimer timer;
+    std::array<qint64, SECTION_COUNT> cpu_start;
+    std::array<int, SECTION_COUNT> cpu_depth; // nesting of the section, only the outer one is timed
+    std::array<double, SECTION_COUNT> cpu_ms; // of the current frame
+
+    std::array<QueryPtr, SECTION_COUNT> gpu_start;
+    std::vector<Interval> intervals; // of the current frame
+    std::deque<PendingFrame> pending;
+    std::vector<QueryPtr> free_queries;
+
+    std::array<RollingStats, SECTION_COUNT> cpu_stats, gpu_stats;
+    std::deque<Record> records;
+};
@@ -7,7 +7,7 @@
 #include <cmath>
 
 void RayCastRenderer::doInit(QOpenGLFunctions *gl) {
-    program = loadProgram("shaders/raycast.vert", "shaders/raycast.frag");
+    loadVariants("shaders/raycast.vert", "shaders/raycast.frag", {"vertex"});
 
     cube = std::make_shared<Cube>();
     cube->attachVertices(program.get(), "vertex");
@@ -16,22 +16,24 @@ void RayCastRenderer::doInit(QOpenGLFunctions *gl) {
 
     gl->glDisable(GL_DEPTH_TEST);
     gl->glEnable(GL_CULL_FACE);
-    gl->glCullFace(GL_BACK);
+    // Back faces are drawn: they are visible even if the eye is inside the box, and ray entry is found analytically.
+    gl->glCullFace(GL_FRONT);
     gl->glFrontFace(GL_CW);
     gl->glEnable(GL_BLEND);
     gl->glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 }
 
-void RayCastRenderer::doRender(QOpenGLFunctions *gl) {    
-    const auto mvp = projection_matrix * view_matrix * model_matrix;
-    program->setUniformValue(program->uniformLocation("MVP"), mvp);    
+void RayCastRenderer::doRender(QOpenGLFunctions *gl) {
+    // Proxy box is shrunk to the part of the volume which can be visible.
+    QVector3D box_min, box_max;
+    if (!visibleBox(box_min, box_max)) {
+        return;
+    }
+    program->setUniformValue(uniformLocation("boxMin"), box_min);
+    program->setUniformValue(uniformLocation("boxMax"), box_max);
 
-    const auto max_dim = std::max(data_texture->width(), std::max(data_texture->height(), data_texture->depth()));
-    const auto step = 1.0f / static_cast<GLfloat>(max_dim * step_multiplier);
-    const auto num_of_steps = static_cast<int>(2.0f * std::sqrt(3.0f) / step);
-    program->setUniformValue(program->uniformLocation("step"), step);
-    program->setUniformValue(program->uniformLocation("numSteps"), num_of_steps);
-    program->setUniformValue(program->uniformLocation("stepMultCoeff"), 1.0f / static_cast<GLfloat>(step_multiplier));
+    const auto mvp = projection_matrix * view_matrix * model_matrix;
+    program->setUniformValue(uniformLocation("MVP"), mvp);
 
     cube->draw(gl);
 }
@@ -1,8 +1,21 @@
 #include "renderer.h"
+#include "brick_atlas.h"
+#include "frame_profiler.h"
+#include "shader_variants.h"
+#include "objects/cube.h"
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLFramebufferObject>
 #include <QOpenGLFunctions>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLPixelTransferOptions>
 #include <QOpenGLShaderProgram>
 #include <QOpenGLTexture>
+#include <algorithm>
+#include <cmath>
 #include <stdexcept>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 #include <random>
 
@@ -19,22 +32,53 @@ std::vector<GLfloat> randomJitter2D(int size) {
     return jitter;
 }
 
+// Radius (in bricks) of the bricks which values reach samples of a brick at the level of detail:
+// a voxel of level l averages about 2^l voxels, and linear filtering reaches a voxel of the level further.
+size_t footprintBricks(float lod, size_t brick_size) {
+    if (lod <= 0.0f) {
+        return 0;
+    }
+    const auto reach = std::exp2(std::ceil(lod) + 1.0f); // in voxels, from the coarser of the blended levels
+    return static_cast<size_t>(std::ceil(reach / static_cast<float>(brick_size)));
+}
+
 }
 
 std::shared_ptr<QOpenGLShaderProgram> Renderer::loadProgram(const char *vert_shader_file, const char *frag_shader_file) {
-    auto prog = std::make_shared<QOpenGLShaderProgram>();
-    if (!prog->addShaderFromSourceFile(QOpenGLShader::Vertex, QString(vert_shader_file))) {
-        throw std::runtime_error(std::string("Failed to load vertex shaders from ") + vert_shader_file
-                                 + ":\n" + prog->log().toStdString());
+    return ShaderVariants::shared(vert_shader_file, frag_shader_file, QStringList(), QStringList())->program(0);
+}
+
+void Renderer::loadVariants(const char *vert_shader_file, const char *frag_shader_file, const QStringList &attributes) {
+    // Names are the defines checked by the shaders, in the order of feature bits.
+    static const QStringList feature_names = {"LIGHTING", "JITTER", "PREINTEGRATION", "GRADIENT", "SKIPPING", "VIRTUAL_TEXTURE", "CHANNELS"};
+    variants = ShaderVariants::shared(vert_shader_file, frag_shader_file, feature_names, attributes);
+    program = variants->program(0);
+}
+
+unsigned int Renderer::features(bool skipping_enabled) const {
+    unsigned int result = 0;
+    if (lighting_enabled) {
+        result |= LIGHTING;
+    }
+    if (jitter_enabled) {
+        result |= JITTER;
     }
-    if (!prog->addShaderFromSourceFile(QOpenGLShader::Fragment, QString(frag_shader_file))) {
-        throw std::runtime_error(std::string("Failed to load fragment shaders from ") + frag_shader_file
-                                 + ":\n" + prog->log().toStdString());
+    if (preintegration_enabled && preintegration_texture) {
+        result |= PREINTEGRATION;
     }
-    if (!prog->link()) {
-        throw std::runtime_error(std::string("Failed to link program:\n") + prog->log().toStdString());
+    if (gradient_texture) {
+        result |= GRADIENT;
     }
-    return prog;
+    if (skipping_enabled) {
+        result |= SKIPPING;
+    }
+    if (virtual_enabled) {
+        result |= VIRTUAL_TEXTURE;
+    }
+    if (channelsEnabled()) {
+        result |= CHANNELS;
+    }
+    return result;
 }
 
 void Renderer::init(QOpenGLFunctions *gl) {
@@ -54,50 +98,483 @@ void Renderer::initJitter(QOpenGLTexture *jitter) {
     jitter->setData(QOpenGLTexture::Red, QOpenGLTexture::Float32, jitter_data.data());
 }
 
+void Renderer::updateLookupTable() {
+    if (!lut_dirty || transfer_function.isEmpty()) {
+        return;
+    }
+    auto values = transfer_function.lookupTable(lut_size);
+    if (values != lut_values) {
+        occupancy_dirty = true;
+    }
+    if (upload_tables && !lut_texture) {
+        lut_texture = std::make_unique<QOpenGLTexture>(QOpenGLTexture::Target1D);
+        lut_texture->setSize(lut_size);
+        lut_texture->setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
+        lut_texture->setWrapMode(QOpenGLTexture::ClampToEdge);
+        lut_texture->setFormat(QOpenGLTexture::RGBA32F);
+        lut_texture->allocateStorage();
+        lut_texture->setData(QOpenGLTexture::RGBA, QOpenGLTexture::Float32, values.data());
+    } else if (upload_tables) {
+        // Only the range of entries which differ is uploaded (e.g. when the cutoff window is dragged).
+        const auto num_of_values = values.size();
+        const auto first = static_cast<size_t>(std::mismatch(lut_values.begin(), lut_values.end(), values.begin()).first - lut_values.begin()) / 4;
+        auto last = num_of_values / 4;
+        while (last > first && std::equal(values.begin() + static_cast<std::ptrdiff_t>(last - 1) * 4,
+                                           values.begin() + static_cast<std::ptrdiff_t>(last) * 4,
+                                           lut_values.begin() + static_cast<std::ptrdiff_t>(last - 1) * 4)) {
+            last--;
+        }
+        if (first < last) {
+            auto *gl = QOpenGLContext::currentContext()->versionFunctions<QOpenGLFunctions_3_3_Core>();
+            lut_texture->bind();
+            gl->glTexSubImage1D(GL_TEXTURE_1D, 0, static_cast<GLint>(first), static_cast<GLsizei>(last - first),
+                                GL_RGBA, GL_FLOAT, values.data() + first * 4);
+            lut_texture->release();
+        }
+    }
+    lut_values = std::move(values);
+    lut_dirty = false;
+}
+
+void Renderer::updatePreintegration() {
+    // Table is rebuilt only when palettes or cutoff change, not every frame.
+    if (!preintegration_dirty || transfer_function.isEmpty()) {
+        return;
+    }
+    preintegration_values = transfer_function.preintegrationTable(preintegration_size);
+    preintegration_dirty = false;
+    if (!upload_tables) {
+        return;
+    }
+    if (!preintegration_texture) {
+        preintegration_texture = std::make_unique<QOpenGLTexture>(QOpenGLTexture::Target2D);
+        preintegration_texture->setSize(preintegration_size, preintegration_size);
+        preintegration_texture->setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
+        preintegration_texture->setWrapMode(QOpenGLTexture::ClampToEdge);
+        preintegration_texture->setFormat(QOpenGLTexture::RGBA32F);
+        preintegration_texture->allocateStorage();
+    }
+    preintegration_texture->setData(QOpenGLTexture::RGBA, QOpenGLTexture::Float32, preintegration_values.data());
+}
+
+void Renderer::updateChannelLookupTable() {
+    if (!channel_lut_dirty) {
+        return;
+    }
+    // Rows of channels without a transfer function are transparent.
+    std::vector<GLfloat> table;
+    table.reserve(static_cast<size_t>(lut_size) * 4 * channel_functions.size());
+    for (const auto &function: channel_functions) {
+        const auto values = function.lookupTable(lut_size);
+        table.insert(table.end(), values.begin(), values.end());
+    }
+    if (!channel_lut_texture) {
+        channel_lut_texture = std::make_unique<QOpenGLTexture>(QOpenGLTexture::Target2D);
+        channel_lut_texture->setSize(lut_size, static_cast<int>(channel_functions.size()));
+        channel_lut_texture->setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
+        channel_lut_texture->setWrapMode(QOpenGLTexture::ClampToEdge);
+        channel_lut_texture->setFormat(QOpenGLTexture::RGBA32F);
+        channel_lut_texture->allocateStorage();
+    }
+    channel_lut_texture->setData(QOpenGLTexture::RGBA, QOpenGLTexture::Float32, table.data());
+    channel_lut_dirty = false;
+}
+
+void Renderer::updateOccupancy() {
+    if (!occupancy_dirty || !brick_volume || lut_values.empty()) {
+        return;
+    }
+    occupancy_values = std::make_unique<Frame3D<unsigned char>>(
+        occupancy_radius > 0 ? brick_volume->dilated(occupancy_radius).occupancy(lut_values, max_step_scale)
+                             : brick_volume->occupancy(lut_values, max_step_scale));
+    const auto &occupancy = *occupancy_values;
+    if (upload_tables) {
+        const auto width = static_cast<int>(occupancy.width());
+        const auto height = static_cast<int>(occupancy.height());
+        const auto depth = static_cast<int>(occupancy.depth());
+        if (!occupancy_texture || occupancy_texture->width() != width ||
+                occupancy_texture->height() != height || occupancy_texture->depth() != depth) {
+            occupancy_texture = std::make_unique<QOpenGLTexture>(QOpenGLTexture::Target3D);
+            occupancy_texture->setSize(width, height, depth);
+            occupancy_texture->setMinMagFilters(QOpenGLTexture::Nearest, QOpenGLTexture::Nearest);
+            occupancy_texture->setWrapMode(QOpenGLTexture::ClampToEdge);
+            occupancy_texture->setFormat(QOpenGLTexture::R8_UNorm);
+            occupancy_texture->allocateStorage();
+        }
+        QOpenGLPixelTransferOptions options;
+        options.setAlignment(1); // rows of bytes are not padded
+        occupancy_texture->setData(QOpenGLTexture::Red, QOpenGLTexture::UInt8, occupancy.data(), &options);
+    }
+
+    size_t min[3] = {occupancy.width(), occupancy.height(), occupancy.depth()};
+    size_t max[3] = {0, 0, 0};
+    for (size_t z = 0; z < occupancy.depth(); z++) {
+        for (size_t y = 0; y < occupancy.height(); y++) {
+            for (size_t x = 0; x < occupancy.width(); x++) {
+                if (occupancy.at(x, y, z)) {
+                    min[0] = std::min(min[0], x);
+                    min[1] = std::min(min[1], y);
+                    min[2] = std::min(min[2], z);
+                    max[0] = std::max(max[0], x + 1);
+                    max[1] = std::max(max[1], y + 1);
+                    max[2] = std::max(max[2], z + 1);
+                }
+            }
+        }
+    }
+    occupied_min = QVector3D(min[0], min[1], min[2]);
+    occupied_max = QVector3D(max[0], max[1], max[2]);
+    occupancy_dirty = false;
+}
+
+bool Renderer::visibleBox(QVector3D &box_min, QVector3D &box_max) const {
+    // Occupancy describes only the data texture, extra channels can be visible anywhere.
+    if (!brick_volume || occupancy_dirty || channelsEnabled()) {
+        box_min = QVector3D(0.0f, 0.0f, 0.0f);
+        box_max = QVector3D(1.0f, 1.0f, 1.0f);
+        return true;
+    }
+    const auto brick_size = static_cast<float>(brick_volume->brickSize());
+    const auto brick = QVector3D(brick_size, brick_size, brick_size) / volumeSize();
+    box_min = occupied_min * brick;
+    box_max = occupied_max * brick;
+    for (int i = 0; i < 3; i++) {
+        box_max[i] = std::min(box_max[i], 1.0f);
+        if (box_min[i] >= box_max[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QVector3D Renderer::volumeSize() const {
+    if (virtual_enabled) {
+        return brick_atlas->volumeSize();
+    }
+    if (!data_texture) {
+        return QVector3D(1.0f, 1.0f, 1.0f);
+    }
+    return QVector3D(data_texture->width(), data_texture->height(), data_texture->depth());
+}
+
+int Renderer::levelCount() const {
+    // Brick atlas has no mip levels.
+    if (virtual_enabled || !data_texture) {
+        return 1;
+    }
+    return data_texture->mipLevels();
+}
+
+float Renderer::levelOfDetail(int viewport_height) const {
+    const auto levels = levelCount();
+    if (levels <= 1 || viewport_height <= 0) {
+        return 0.0f;
+    }
+    // Data cube has side length of 2 in model space; its center is at the origin.
+    const auto center = view_matrix * model_matrix * QVector4D(0.0f, 0.0f, 0.0f, 1.0f);
+    const auto distance = std::max(-center.z(), 1e-3f);
+    const auto size = volumeSize();
+    const auto max_dim = std::max(size.x(), std::max(size.y(), size.z()));
+    const auto voxel_pixels = 2.0f / max_dim * projection_matrix(1, 1) * 0.5f * static_cast<float>(viewport_height) / distance;
+    // Level where a voxel covers about a pixel; one more while interacting.
+    auto level = std::log2(1.0f / voxel_pixels) + (interacting ? 1.0f : 0.0f);
+    return std::min(std::max(level, 0.0f), static_cast<float>(levels - 1));
+}
+
+void Renderer::setPagingUniforms(QOpenGLShaderProgram *prog) {
+    prog->setUniformValue(prog->uniformLocation("pageTable"), 6);
+    prog->setUniformValue(prog->uniformLocation("virtualEnabled"), virtual_enabled);
+    if (virtual_enabled) {
+        prog->setUniformValue(prog->uniformLocation("volumeSize"), brick_atlas->volumeSize());
+        prog->setUniformValue(prog->uniformLocation("pageSize"), static_cast<GLfloat>(brick_atlas->brickSize()));
+        prog->setUniformValue(prog->uniformLocation("atlasSize"), static_cast<GLfloat>(brick_atlas->texture()->width()));
+    }
+}
+
+size_t Renderer::renderFeedback(QOpenGLFunctions *gl) {
+    if (!feedback_program) {
+        feedback_program = loadProgram("shaders/raycast.vert", "shaders/feedback.frag");
+        feedback_cube = std::make_shared<Cube>();
+        feedback_cube->attachVertices(feedback_program.get(), "vertex");
+    }
+    QVector3D box_min, box_max;
+    if (!visibleBox(box_min, box_max)) {
+        return 0;
+    }
+
+    GLint viewport[4], prev_fbo = 0, cull_mode = 0, front_face = 0;
+    gl->glGetIntegerv(GL_VIEWPORT, viewport);
+    gl->glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prev_fbo);
+    gl->glGetIntegerv(GL_CULL_FACE_MODE, &cull_mode);
+    gl->glGetIntegerv(GL_FRONT_FACE, &front_face);
+    const auto cull_enabled = gl->glIsEnabled(GL_CULL_FACE);
+    const auto blend_enabled = gl->glIsEnabled(GL_BLEND);
+
+    const auto width = std::max(viewport[2] / feedback_scale, 1);
+    const auto height = std::max(viewport[3] / feedback_scale, 1);
+    if (!feedback_fbo || feedback_fbo->width() != width || feedback_fbo->height() != height) {
+        // Missing bricks go into the first attachment, used ones into the second.
+        feedback_fbo = std::make_unique<QOpenGLFramebufferObject>(width, height, QOpenGLFramebufferObject::NoAttachment,
+                                                                  GL_TEXTURE_2D, GL_RGBA8);
+        feedback_fbo->addColorAttachment(width, height, GL_RGBA8);
+    }
+    auto *extra = QOpenGLContext::currentContext()->extraFunctions();
+    feedback_fbo->bind();
+    const GLenum buffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    extra->glDrawBuffers(2, buffers);
+    gl->glViewport(0, 0, width, height);
+    gl->glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    gl->glClear(GL_COLOR_BUFFER_BIT);
+    gl->glDisable(GL_BLEND);
+    gl->glEnable(GL_CULL_FACE);
+    gl->glCullFace(GL_FRONT);
+    gl->glFrontFace(GL_CW);
+
+    const auto size = volumeSize();
+    const auto base_step = 1.0f / (std::max(size.x(), std::max(size.y(), size.z())) * static_cast<GLfloat>(step_multiplier));
+    feedback_program->bind();
+    feedback_program->setUniformValue(feedback_program->uniformLocation("texture3d"), 0);
+    feedback_program->setUniformValue(feedback_program->uniformLocation("transferFunction"), 1);
+    feedback_program->setUniformValue(feedback_program->uniformLocation("occupancy"), 5);
+    setPagingUniforms(feedback_program.get());
+    const auto skipping_enabled = brick_volume && occupancy_values && !occupancy_dirty;
+    feedback_program->setUniformValue(feedback_program->uniformLocation("skippingEnabled"), skipping_enabled);
+    if (skipping_enabled) {
+        const auto brick_size = static_cast<GLfloat>(brick_volume->brickSize());
+        feedback_program->setUniformValue(feedback_program->uniformLocation("brickSize"),
+                                          QVector3D(brick_size, brick_size, brick_size) / size);
+    }
+    feedback_program->setUniformValue(feedback_program->uniformLocation("pageTableSize"), brick_atlas->pageTableSize());
+    feedback_program->setUniformValue(feedback_program->uniformLocation("frameIndex"), static_cast<GLfloat>(feedback_frame++ % 1024));
+    feedback_program->setUniformValue(feedback_program->uniformLocation("boxMin"), box_min);
+    feedback_program->setUniformValue(feedback_program->uniformLocation("boxMax"), box_max);
+    feedback_program->setUniformValue(feedback_program->uniformLocation("MVP"), projection_matrix * view_matrix * model_matrix);
+    const auto eye = (view_matrix * model_matrix).inverted() * QVector4D(0.0f, 0.0f, 0.0f, 1.0f);
+    feedback_program->setUniformValue(feedback_program->uniformLocation("eyePosition"), QVector3D(eye.x(), eye.y(), eye.z()));
+    feedback_program->setUniformValue(feedback_program->uniformLocation("step"), base_step);
+    feedback_program->setUniformValue(feedback_program->uniformLocation("numSteps"), static_cast<int>(2.0f * std::sqrt(3.0f) / base_step));
+    feedback_program->setUniformValue(feedback_program->uniformLocation("stepMultCoeff"), 1.0f / static_cast<GLfloat>(step_multiplier));
+    feedback_cube->draw(gl);
+    feedback_program->release();
+
+    // Brick ids are stored plus one, so zero means none; bricks are ordered by the number of rays which need them.
+    std::vector<GLuint> pixels(static_cast<size_t>(width * height));
+    std::vector<size_t> bricks[2];
+    for (int i = 0; i < 2; i++) {
+        extra->glReadBuffer(GL_COLOR_ATTACHMENT0 + static_cast<GLenum>(i));
+        gl->glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        std::unordered_map<size_t, size_t> counts;
+        for (auto id: pixels) {
+            if (id != 0) {
+                counts[id - 1]++;
+            }
+        }
+        std::vector<std::pair<size_t, size_t>> sorted(counts.begin(), counts.end());
+        std::sort(sorted.begin(), sorted.end(), [](const std::pair<size_t, size_t> &a, const std::pair<size_t, size_t> &b) {
+            return a.second > b.second;
+        });
+        for (const auto &entry: sorted) {
+            bricks[i].push_back(entry.first);
+        }
+    }
+
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(prev_fbo));
+    gl->glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    gl->glCullFace(static_cast<GLenum>(cull_mode));
+    gl->glFrontFace(static_cast<GLenum>(front_face));
+    if (!cull_enabled) {
+        gl->glDisable(GL_CULL_FACE);
+    }
+    if (blend_enabled) {
+        gl->glEnable(GL_BLEND);
+    }
+
+    return brick_atlas->page(bricks[1], bricks[0], static_cast<size_t>(max_page_loads));
+}
+
+void Renderer::prepareProgram(QOpenGLExtraFunctions *gl) {
+    if (uniform_locations.count(program.get()) != 0) {
+        return;
+    }
+    uniform_locations[program.get()] = {};
+    // Texture units don't change, so samplers are set once per program.
+    program->setUniformValue("texture3d", 0);
+    program->setUniformValue("transferFunction", 1);
+    program->setUniformValue("jitter", 2);
+    program->setUniformValue("preintegrated", 3);
+    program->setUniformValue("gradientTexture", 4);
+    program->setUniformValue("occupancy", 5);
+    program->setUniformValue("pageTable", 6);
+    program->setUniformValue("channels", 7);
+    program->setUniformValue("channelFunctions", 8);
+    const std::pair<const char *, GLuint> blocks[] = {
+        {"FrameState", frame_uniforms.bindingPoint()},
+        {"VolumeState", volume_uniforms.bindingPoint()}
+    };
+    for (const auto &block: blocks) {
+        const auto index = gl->glGetUniformBlockIndex(program->programId(), block.first);
+        if (index != GL_INVALID_INDEX) {
+            gl->glUniformBlockBinding(program->programId(), index, block.second);
+        }
+    }
+}
+
+GLint Renderer::uniformLocation(const char *name) {
+    auto &locations = uniform_locations[program.get()];
+    auto it = locations.find(name);
+    if (it == locations.end()) {
+        it = locations.emplace(name, program->uniformLocation(name)).first;
+    }
+    return it->second;
+}
+
+void Renderer::updateUniforms(bool skipping_enabled) {
+    const auto size = volumeSize();
+    const auto max_dim = std::max(size.x(), std::max(size.y(), size.z()));
+    // Voxels of coarser levels are larger, so are the steps.
+    const auto lod_scale = std::exp2(lod);
+    step = lod_scale / (max_dim * static_cast<GLfloat>(step_multiplier));
+
+    const auto mvInv = (view_matrix * model_matrix).inverted();
+    const auto eye = mvInv * QVector4D(0.0f, 0.0f, 0.0f, 1.0f);
+    const auto light = mvInv * QVector4D(-5.0f, -5.0f, -5.0f, 1.0f);
+    auto &frame = frame_uniforms.data();
+    setVec3(frame.eye_position, QVector3D(eye.x(), eye.y(), eye.z()));
+    setVec3(frame.light_position, QVector3D(light.x(), light.y(), light.z()));
+    frame.step = step;
+    frame.step_mult_coeff = lod_scale / static_cast<GLfloat>(step_multiplier);
+    frame.lod = lod;
+    frame.num_steps = static_cast<GLint>(2.0f * std::sqrt(3.0f) / step);
+    frame.jitter_size = jitter_size;
+
+    auto &volume = volume_uniforms.data();
+    volume.preintegration_size = preintegration_size;
+    volume.num_channels = extra_channels;
+    if (skipping_enabled) {
+        const auto brick_size = static_cast<GLfloat>(brick_volume->brickSize());
+        setVec3(volume.brick_size, QVector3D(brick_size, brick_size, brick_size) / size);
+    }
+    if (virtual_enabled) {
+        setVec3(volume.volume_size, brick_atlas->volumeSize());
+        volume.page_size = static_cast<GLfloat>(brick_atlas->brickSize());
+        volume.atlas_size = static_cast<GLfloat>(brick_atlas->texture()->width());
+    }
+}
+
+void Renderer::updateLevelOfDetail(int viewport_height) {
+    lod = levelOfDetail(viewport_height);
+    // Coarser levels mix values across brick borders, so bricks are occupied by their neighbours too.
+    const auto radius = (brick_volume ? footprintBricks(lod, brick_volume->brickSize()) : 0);
+    if (radius != occupancy_radius) {
+        occupancy_radius = radius;
+        occupancy_dirty = true;
+    }
+}
+
+void Renderer::updateTables() {
+    if (profiler) {
+        profiler->begin(FrameProfiler::PALETTE);
+    }
+    updateLookupTable();
+    updateOccupancy();
+    if (preintegration_enabled) {
+        updatePreintegration();
+    }
+    if (channelsEnabled() && upload_tables) {
+        updateChannelLookupTable();
+    }
+    if (profiler) {
+        profiler->end(FrameProfiler::PALETTE);
+    }
+}
+
+bool Renderer::skippingEnabled() const {
+    return brick_volume && occupancy_values && !occupancy_dirty && !channelsEnabled();
+}
+
 void Renderer::render(QOpenGLFunctions *gl) {
-    if (!program || !data_texture || !color_texture || !opacity_texture) {
+    if (!program || (!data_texture && !brick_atlas) || transfer_function.isEmpty()) {
         return;
     }
+    virtual_enabled = brick_atlas && brick_atlas->prepare();
+    paging = false;
+    if (!virtual_enabled && !data_texture) {
+        return;
+    }
+    auto *volume_texture = (virtual_enabled ? brick_atlas->texture() : data_texture);
 
-    program->bind();
+    GLint viewport[4];
+    gl->glGetIntegerv(GL_VIEWPORT, viewport);
+    updateLevelOfDetail(viewport[3]);
+
+    if (profiler) {
+        profiler->begin(FrameProfiler::RENDER);
+    }
+    updateTables();
 
-    program->setUniformValue(program->uniformLocation("cutoffLow"), cutoff_low);
-    program->setUniformValue(program->uniformLocation("cutoffHigh"), cutoff_high);
-    const auto cutoff_coeff = (std::abs(cutoff_low - cutoff_high) > 1e-8f ? 1.0f / (cutoff_high - cutoff_low) : 1.0f);
-    program->setUniformValue(program->uniformLocation("cutoffCoeff"), cutoff_coeff);
+    // Variant with only the enabled features compiled in; uniform blocks are shared by all variants, so switching is cheap.
+    const auto skipping_enabled = skippingEnabled();
+    if (variants) {
+        program = variants->program(features(skipping_enabled));
+    }
+    program->bind();
+    prepareProgram(QOpenGLContext::currentContext()->extraFunctions());
 
     gl->glActiveTexture(GL_TEXTURE0);
-    program->setUniformValue(program->uniformLocation("texture3d"), 0);
-    data_texture->bind();
+    volume_texture->bind();
 
     gl->glActiveTexture(GL_TEXTURE1);
-    program->setUniformValue(program->uniformLocation("palette"), 1);
-    color_texture->bind();
+    lut_texture->bind();
 
     gl->glActiveTexture(GL_TEXTURE2);
-    program->setUniformValue(program->uniformLocation("opacity"), 2);
-    opacity_texture->bind();
+    jitter_texture->bind();
 
     gl->glActiveTexture(GL_TEXTURE3);
-    program->setUniformValue(program->uniformLocation("jitter"), 3);
-    jitter_texture->bind();
+    if (preintegration_texture) {
+        preintegration_texture->bind();
+    }
 
-    program->setUniformValue(program->uniformLocation("jitterSize"), jitter_size);
-    program->setUniformValue(program->uniformLocation("jitterEnabled"), jitter_enabled);
+    gl->glActiveTexture(GL_TEXTURE4);
+    if (gradient_texture) {
+        gradient_texture->bind();
+    }
 
-    const auto mvInv = (view_matrix * model_matrix).inverted();
-    const auto eye = mvInv * QVector4D(0.0f, 0.0f, 0.0f, 1.0f);
-    const auto light = mvInv * QVector4D(-5.0f, -5.0f, -5.0f, 1.0f);
-    program->setUniformValue(program->uniformLocation("eyePosition"), QVector3D(eye.x(), eye.y(), eye.z()));
-    program->setUniformValue(program->uniformLocation("lightPosition"), QVector3D(light.x(), light.y(), light.z()));
-    program->setUniformValue(program->uniformLocation("lightingEnabled"), lighting_enabled);
+    gl->glActiveTexture(GL_TEXTURE5);
+    if (occupancy_texture) {
+        occupancy_texture->bind();
+    }
 
-    doRender(gl);
+    gl->glActiveTexture(GL_TEXTURE6);
+    if (virtual_enabled) {
+        brick_atlas->pageTable()->bind();
+    }
+
+    if (channelsEnabled()) {
+        gl->glActiveTexture(GL_TEXTURE7);
+        channel_texture->bind();
+        gl->glActiveTexture(GL_TEXTURE8);
+        channel_lut_texture->bind();
+    }
 
-    data_texture->release();
-    color_texture->release();
-    opacity_texture->release();
+    updateUniforms(skipping_enabled);
+    // Only changed blocks are uploaded.
+    auto *extra = QOpenGLContext::currentContext()->extraFunctions();
+    frame_uniforms.upload(extra);
+    volume_uniforms.upload(extra);
+
+    doRender(gl);
 
     program->release();
-}
 
+    if (virtual_enabled) {
+        // Feedback pass uses textures which are still bound.
+        paging = (renderFeedback(gl) > 0);
+    }
+
+    volume_texture->release();
+    lut_texture->release();
+
+    if (profiler) {
+        profiler->end(FrameProfiler::RENDER);
+    }
+}
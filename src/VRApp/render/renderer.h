@@ -1,20 +1,39 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include <QMatrix4x4>
+#include <QOpenGLFramebufferObject>
+#include <QStringList>
+
+#include "brick_volume.h"
+#include "transfer_function.h"
+#include "uniform_buffer.h"
 
 class QOpenGLContext;
 class QOpenGLShaderProgram;
 class QOpenGLFunctions;
 class QOpenGLTexture;
+class BrickAtlas;
+class Cube;
+class FrameProfiler;
+class ShaderVariants;
 
 class Renderer {
 public:
+    // The data texture and the extra channels.
+    static const int max_channels = 4;
+
     Renderer() = default;
     virtual ~Renderer() = default;
 
     void init(QOpenGLFunctions *gl);
-    void render(QOpenGLFunctions *gl);
+    // Binds the volume textures and tables, uploads uniform blocks, then draws by doRender().
+    virtual void render(QOpenGLFunctions *gl);
 
     void enableLighting(bool enabled) {
         lighting_enabled = enabled;
@@ -28,12 +47,71 @@ public:
         data_texture = tex;
     }
 
-    void setColorTexture(QOpenGLTexture *tex) {
-        color_texture = tex;
+    // Precomputed gradients for lighting; if there is none, shaders compute gradients on the fly.
+    void setGradientTexture(QOpenGLTexture *tex) {
+        gradient_texture = tex;
+    }
+
+    // Virtual texture for a volume which doesn't fit GPU memory; it's used instead of the data texture.
+    // Rays report bricks they need in a low-resolution feedback pass after each render, and missing ones are paged in.
+    void setBrickAtlas(std::shared_ptr<BrickAtlas> atlas) {
+        brick_atlas = atlas;
+    }
+
+    // True if bricks have been paged in on the last render, so the next one shows more data.
+    bool isPaging() const {
+        return paging;
+    }
+
+    // Value ranges of bricks of the current data texture, to skip empty space; null disables skipping.
+    void setBrickVolume(std::shared_ptr<const BrickVolume> bricks) {
+        if (bricks != brick_volume) {
+            brick_volume = bricks;
+            occupancy_dirty = true;
+        }
+    }
+
+    // Palettes and cutoff are baked into lookup tables, which are rebuilt on the next render after a change.
+    void setColorPalette(const std::vector<QVector3D> &colors) {
+        if (transfer_function.setColors(colors)) {
+            lut_dirty = preintegration_dirty = true;
+        }
+    }
+
+    void setOpacityPalette(const std::vector<GLfloat> &values) {
+        if (transfer_function.setOpacities(values)) {
+            lut_dirty = preintegration_dirty = true;
+        }
+    }
+
+    // Co-registered volumes composited with the data texture in the same ray march, packed into color components
+    // of one texture: component i holds channel i + 1 (the data texture is channel 0). Null texture disables them.
+    void setChannelTexture(QOpenGLTexture *tex, int count) {
+        channel_texture = tex;
+        extra_channels = (tex ? std::min(count, max_channels - 1) : 0);
+    }
+
+    // Each extra channel has its own transfer function; channel is in [1, max_channels).
+    void setChannelColorPalette(int channel, const std::vector<QVector3D> &colors) {
+        if (channel_functions.at(static_cast<size_t>(channel - 1)).setColors(colors)) {
+            channel_lut_dirty = true;
+        }
+    }
+
+    void setChannelOpacityPalette(int channel, const std::vector<GLfloat> &values) {
+        if (channel_functions.at(static_cast<size_t>(channel - 1)).setOpacities(values)) {
+            channel_lut_dirty = true;
+        }
+    }
+
+    void setChannelCutoff(int channel, float low, float high) {
+        if (channel_functions.at(static_cast<size_t>(channel - 1)).setCutoff(low, high)) {
+            channel_lut_dirty = true;
+        }
     }
 
-    void setOpacityTexture(QOpenGLTexture *tex) {
-        opacity_texture = tex;
+    void enablePreintegration(bool enabled) {
+        preintegration_enabled = enabled;
     }
 
     void setMVP(const QMatrix4x4 &model, const QMatrix4x4 &view, const QMatrix4x4 &proj) {
@@ -45,20 +123,91 @@ public:
     void setCutoff(float low, float high) {
         cutoff_low = low;
         cutoff_high = high;
+        if (transfer_function.setCutoff(low, high)) {
+            lut_dirty = preintegration_dirty = true;
+        }
+    }
+
+    // While interacting, a coarser level of detail is rendered.
+    void setInteracting(bool enabled) {
+        interacting = enabled;
     }
 
     void setStepMultiplier(int multipl) {
         step_multiplier = multipl;
     }
 
+    // Render and palette uploads are timed by the profiler, if any.
+    void setProfiler(FrameProfiler *prof) {
+        profiler = prof;
+    }
+
 protected:
+    // Optional features of volume shaders; they are compiled into program variants instead of being checked per sample.
+    enum Feature : unsigned int {
+        LIGHTING = 1u << 0,
+        JITTER = 1u << 1,
+        PREINTEGRATION = 1u << 2,
+        GRADIENT = 1u << 3,
+        SKIPPING = 1u << 4,
+        VIRTUAL_TEXTURE = 1u << 5,
+        CHANNELS = 1u << 6
+    };
+
+
     static std::shared_ptr<QOpenGLShaderProgram> loadProgram(const char *vert_shader_file, const char *frag_shader_file);
 
+    // Volume shaders with feature variants; the program without features becomes current, so vertex arrays can be set up.
+    // Attributes get locations by their order, the same in all variants.
+    void loadVariants(const char *vert_shader_file, const char *frag_shader_file, const QStringList &attributes);
+
+    // Bounding box (in texture coordinates) of bricks which can be visible with the current classification.
+    // Returns false if nothing is visible. Without brick volume or with extra channels, the box is the whole volume.
+    bool visibleBox(QVector3D &box_min, QVector3D &box_max) const;
+
+    // Location of a uniform of the current program which isn't in a uniform block; looked up once per program.
+    GLint uniformLocation(const char *name);
+
+    // Mip level of the data texture to sample, from the screen size of a voxel.
+    float levelOfDetail(int viewport_height) const;
+
+    // Size of the volume in voxels: of the data texture, or of the frame paged into the brick atlas.
+    virtual QVector3D volumeSize() const;
+
+    // Number of mip levels which can be sampled.
+    virtual int levelCount() const;
+
+    // Level of detail for the viewport, and the dilation of occupancy it needs.
+    void updateLevelOfDetail(int viewport_height);
+
+    // Rebuild the lookup tables, occupancy and preintegration table which are out of date; timed as palette updates.
+    void updateTables();
+
+    // Empty space skipping is possible if occupancy describes the current classification of the whole rendered data.
+    bool skippingEnabled() const;
+
+    // Fill uniform blocks from the current state (step, eye and light are also used by the CPU ray caster);
+    // they are uploaded separately.
+    void updateUniforms(bool skipping_enabled);
+
     virtual void doInit(QOpenGLFunctions *gl) = 0;
     virtual void doRender(QOpenGLFunctions *gl) = 0;
 
 private:
     void initJitter(QOpenGLTexture *jitter);
+    unsigned int features(bool skipping_enabled) const;
+    // On the first use of the current program, samplers get their texture units and blocks their binding points.
+    void prepareProgram(QOpenGLExtraFunctions *gl);
+    void updateLookupTable();
+    void updatePreintegration();
+    void updateOccupancy();
+    void updateChannelLookupTable();
+    bool channelsEnabled() const {
+        return channel_texture && extra_channels > 0;
+    }
+    void setPagingUniforms(QOpenGLShaderProgram *prog);
+    // Returns the number of paged in bricks.
+    size_t renderFeedback(QOpenGLFunctions *gl);
 
 protected:
     QMatrix4x4 model_matrix;
@@ -66,16 +215,58 @@ protected:
     QMatrix4x4 projection_matrix;
 
     QOpenGLTexture *data_texture = nullptr;
-    QOpenGLTexture *color_texture = nullptr;
-    QOpenGLTexture *opacity_texture = nullptr;
+    QOpenGLTexture *gradient_texture = nullptr;
+    QOpenGLTexture *channel_texture = nullptr;
+    std::unique_ptr<QOpenGLTexture> channel_lut_texture; // a row per extra channel
+    std::unique_ptr<QOpenGLTexture> lut_texture;
     std::unique_ptr<QOpenGLTexture> jitter_texture;
+    std::unique_ptr<QOpenGLTexture> preintegration_texture;
+    std::unique_ptr<QOpenGLTexture> occupancy_texture;
+
+    std::shared_ptr<const BrickVolume> brick_volume;
+    std::shared_ptr<BrickAtlas> brick_atlas;
+    QVector3D occupied_min, occupied_max; // in bricks, max is exclusive
+
+    // Host copies of the tables; they're also uploaded into textures unless upload_tables is false.
+    TransferFunction transfer_function;
+    std::vector<GLfloat> lut_values;
+    std::vector<GLfloat> preintegration_values;
+    std::unique_ptr<Frame3D<unsigned char>> occupancy_values; // step scale of each brick, see BrickVolume::occupancy()
+    std::array<TransferFunction, max_channels - 1> channel_functions;
 
-    std::shared_ptr<QOpenGLShaderProgram> program;
+    std::shared_ptr<QOpenGLShaderProgram> program; // variant for the current features, selected on each render
+    std::shared_ptr<ShaderVariants> variants;
+    FrameProfiler *profiler = nullptr;
+    std::unordered_map<const QOpenGLShaderProgram *, std::unordered_map<std::string, GLint>> uniform_locations;
+    UniformBuffer<FrameUniforms> frame_uniforms {0};
+    UniformBuffer<VolumeUniforms> volume_uniforms {1};
+    std::shared_ptr<QOpenGLShaderProgram> feedback_program;
+    std::shared_ptr<Cube> feedback_cube;
+    std::unique_ptr<QOpenGLFramebufferObject> feedback_fbo;
 
     float cutoff_low {0.0f}, cutoff_high {1.0f};
 
     int step_multiplier = 1;
+    int extra_channels = 0;
     int jitter_size = 64;
+    int lut_size = 1024;
+    int max_step_scale = 8; // longest step in homogeneous bricks, in base steps
+    int preintegration_size = 256;
+    int feedback_scale = 8; // feedback pass has this times lower resolution than the viewport
+    int max_page_loads = 64; // bricks paged in per render
+    size_t occupancy_radius {0}; // bricks are dilated by it for the level of detail
+    unsigned int feedback_frame = 0;
+    float lod {0.0f}; // current level of detail, set on each render
+    float step {0.0f}; // base sampling step in texture coordinates, set on each render
+    bool upload_tables = true;
+    bool virtual_enabled = false; // brick atlas is rendered instead of the data texture
+    bool paging = false;
+    bool interacting = false;
     bool lighting_enabled = false;
     bool jitter_enabled = false;
+    bool preintegration_enabled = false;
+    bool lut_dirty = true;
+    bool preintegration_dirty = true;
+    bool occupancy_dirty = true;
+    bool channel_lut_dirty = true;
 };
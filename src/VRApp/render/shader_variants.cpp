@@ -0,0 +1,110 @@
+#include "shader_variants.h"
+
+#include <QFile>
+#include <QOpenGLContext>
+#include <QOpenGLShaderProgram>
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+QByteArray readSource(const QString &file_name) {
+    QFile file(file_name);
+    if (!file.open(QIODevice::ReadOnly)) {
+        throw std::runtime_error("Failed to read shader source from " + file_name.toStdString());
+    }
+    return file.readAll();
+}
+
+using SharedVariants = std::map<std::pair<QOpenGLContext *, QString>, std::shared_ptr<ShaderVariants>>;
+
+SharedVariants &sharedVariants() {
+    static SharedVariants variants;
+    return variants;
+}
+
+}
+
+std::shared_ptr<ShaderVariants> ShaderVariants::shared(const QString &vert_shader_file, const QString &frag_shader_file,
+                                                       const QStringList &feature_names, const QStringList &attributes) {
+    auto *context = QOpenGLContext::currentContext();
+    const auto key = std::make_pair(context, vert_shader_file + "|" + frag_shader_file + "|" +
+                                    feature_names.join(",") + "|" + attributes.join(","));
+    auto &variants = sharedVariants();
+    auto it = variants.find(key);
+    if (it != variants.end()) {
+        return it->second;
+    }
+    const auto known_context = std::any_of(variants.begin(), variants.end(), [context](const SharedVariants::value_type &entry) {
+        return entry.first.first == context;
+    });
+    if (!known_context) {
+        // Programs are freed while the context is still current.
+        QObject::connect(context, &QOpenGLContext::aboutToBeDestroyed, [context]() {
+            auto &variants = sharedVariants();
+            for (auto it = variants.begin(); it != variants.end();) {
+                it = (it->first.first == context ? variants.erase(it) : std::next(it));
+            }
+        });
+    }
+    auto result = std::make_shared<ShaderVariants>(vert_shader_file, frag_shader_file, feature_names, attributes);
+    variants.emplace(key, result);
+    return result;
+}
+
+ShaderVariants::ShaderVariants(const QString &vert_shader_file, const QString &frag_shader_file,
+                               const QStringList &feature_names, const QStringList &attributes) :
+    vert_file(vert_shader_file),
+    frag_file(frag_shader_file),
+    vert_code(readSource(vert_shader_file)),
+    frag_code(readSource(frag_shader_file)),
+    feature_names(feature_names),
+    attributes(attributes)
+{
+}
+
+QByteArray ShaderVariants::source(const QByteArray &code, unsigned int features) const {
+    QByteArray defines;
+    for (int i = 0; i < feature_names.size(); i++) {
+        if (features & (1u << i)) {
+            defines += "#define " + feature_names[i].toLatin1() + "\n";
+        }
+    }
+    // Defines go right after the #version directive, which must come first.
+    const auto version = code.indexOf("#version");
+    const auto line_end = (version < 0 ? -1 : code.indexOf('\n', version));
+    if (line_end < 0) {
+        return defines + code;
+    }
+    auto result = code;
+    result.insert(line_end + 1, defines);
+    return result;
+}
+
+std::shared_ptr<QOpenGLShaderProgram> ShaderVariants::program(unsigned int features) {
+    auto it = programs.find(features);
+    if (it != programs.end()) {
+        return it->second;
+    }
+    auto prog = std::make_shared<QOpenGLShaderProgram>();
+    if (!prog->addCacheableShaderFromSourceCode(QOpenGLShader::Vertex, source(vert_code, features))) {
+        throw std::runtime_error("Failed to compile vertex shader " + vert_file.toStdString()
+                                 + ":\n" + prog->log().toStdString());
+    }
+    if (!prog->addCacheableShaderFromSourceCode(QOpenGLShader::Fragment, source(frag_code, features))) {
+        throw std::runtime_error("Failed to compile fragment shader " + frag_file.toStdString()
+                                 + ":\n" + prog->log().toStdString());
+    }
+    for (int i = 0; i < attributes.size(); i++) {
+        prog->bindAttributeLocation(attributes[i], i);
+    }
+    // Cacheable shaders are compiled on link, unless the binary is found in the cache, so errors show up here.
+    if (!prog->link()) {
+        throw std::runtime_error("Failed to link program from " + vert_file.toStdString() + " and "
+                                 + frag_file.toStdString() + ":\n" + prog->log().toStdString());
+    }
+    programs.emplace(features, prog);
+    return prog;
+}
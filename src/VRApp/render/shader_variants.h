@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+#include <map>
+#include <memory>
+
+class QOpenGLShaderProgram;
+
+/*
+ * Programs built from the same pair of shader files with different sets of features, compiled on first use.
+ * A feature is enabled by a #define injected after the #version directive, so disabled features cost nothing
+ * in the shaders. Attribute locations are bound before linking, so a vertex array set up with one variant
+ * works with all of them. Linked program binaries are cached on disk by Qt (keyed by the sources and
+ * the driver), so a program which has been built once is loaded on the next start instead of compiled.
+ * Methods should be called with the GL context current.
+ */
+class ShaderVariants {
+public:
+    // Bit i of a feature mask enables the define feature_names[i].
+    ShaderVariants(const QString &vert_shader_file, const QString &frag_shader_file,
+                   const QStringList &feature_names, const QStringList &attributes);
+
+    // Variants of the shader files shared by everything rendered in the current context, so a new renderer
+    // reuses programs which are already built. They are destroyed with the context.
+    static std::shared_ptr<ShaderVariants> shared(const QString &vert_shader_file, const QString &frag_shader_file,
+                                                  const QStringList &feature_names, const QStringList &attributes);
+
+    // Program with the features of the mask; throws if it fails to compile.
+    std::shared_ptr<QOpenGLShaderProgram> program(unsigned int features);
+
+    // Source with the defines of the mask.
+    QByteArray source(const QByteArray &code, unsigned int features) const;
+
+private:
+    QString vert_file, frag_file;
+    QByteArray vert_code, frag_code;
+    QStringList feature_names;
+    QStringList attributes;
+    std::map<unsigned int, std::shared_ptr<QOpenGLShaderProgram>> programs;
+};
@@ -1,16 +1,19 @@
 #include "slice_renderer.h"
-#include "objects/plane.h"
 
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
 #include <QOpenGLFunctions>
 #include <QOpenGLTexture>
 #include <QOpenGLShaderProgram>
+#include <algorithm>
+#include <array>
 #include <cmath>
 
 void SliceRenderer::doInit(QOpenGLFunctions *gl) {
-    program = loadProgram("shaders/slice.vert", "shaders/slice.frag");
+    loadVariants("shaders/slice.vert", "shaders/slice.frag", {});
 
-    plane = std::make_shared<Plane>();
-    plane->attachVertices(program.get(), "vertex");
+    slice_vao = std::make_unique<QOpenGLVertexArrayObject>();
+    slice_vao->create();
 
     texture_matrix.setToIdentity();
     texture_matrix.scale(2.0f);
@@ -22,30 +25,53 @@ void SliceRenderer::doInit(QOpenGLFunctions *gl) {
     gl->glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 }
 
-void SliceRenderer::doRender(QOpenGLFunctions *gl) {
-    const auto proj_loc = program->uniformLocation("Proj");
-    const auto tex_inv_loc = program->uniformLocation("TexInv");
-
+void SliceRenderer::doRender(QOpenGLFunctions *) {
     static const float cube_half_size = 1.0f; // cube vertices' coords are +1/-1
     static const float cube_extent_radius = cube_half_size * std::sqrt(3.0f); // radius of a sphere around cube
 
+    // Only the part of the volume which can be visible is sliced.
+    QVector3D box_min, box_max;
+    if (!visibleBox(box_min, box_max)) {
+        return;
+    }
+
     // Data cube is located in [0,0,0] in world coordinates and has side length of 2.
     const auto view_distance = (view_matrix * QVector4D(0, 0, 0, 1)).length(); // distance from the camera to the origin
-    const auto max_dim = std::max(data_texture->width(), std::max(data_texture->height(), data_texture->depth()));
-    const auto step = 1.0f / static_cast<GLfloat>(max_dim * step_multiplier);
-    const auto num_of_steps = static_cast<int>(2.0f * cube_extent_radius / step);
-    program->setUniformValue(program->uniformLocation("step"), step);
-    program->setUniformValue(program->uniformLocation("stepMultCoeff"), 1.0f / static_cast<GLfloat>(step_multiplier));
-
-    const auto texture_inverse_matrix = (view_matrix * model_matrix * texture_matrix).inverted();
-    QMatrix4x4 plane_model_matrix;
-    plane_model_matrix.scale(cube_extent_radius, cube_extent_radius, 1); // scale plane to fit over cube
-    plane_model_matrix.translate(0, 0, -view_distance - cube_extent_radius); // plane is in view space
-
-    for (int i = 0; i <= num_of_steps; i++) {
-        program->setUniformValue(proj_loc, projection_matrix * plane_model_matrix);
-        program->setUniformValue(tex_inv_loc, texture_inverse_matrix * plane_model_matrix);
-        plane->draw(gl);
-        plane_model_matrix.translate(0, 0, step);
+
+    // Slices are view aligned planes clipped by the visible box; their positions don't depend on the box, so they stay put.
+    const auto texture_to_eye = view_matrix * model_matrix * texture_matrix;
+    std::array<QVector3D, 8> corners;
+    for (size_t i = 0; i < corners.size(); i++) {
+        const QVector3D corner((i & 1) ? box_max.x() : box_min.x(),
+                               (i & 2) ? box_max.y() : box_min.y(),
+                               (i & 4) ? box_max.z() : box_min.z());
+        corners[i] = texture_to_eye * corner;
+    }
+    if (step <= 0.0f) {
+        return;
     }
+    auto z_min = corners[0].z(), z_max = corners[0].z();
+    for (const auto &corner: corners) {
+        z_min = std::min(z_min, corner.z());
+        z_max = std::max(z_max, corner.z());
+    }
+    const auto z_origin = -view_distance - cube_extent_radius;
+    const auto first = std::ceil((z_min - z_origin) / step);
+    const auto last = std::floor((z_max - z_origin) / step);
+    if (last < first) {
+        return;
+    }
+
+    program->setUniformValue(uniformLocation("Proj"), projection_matrix);
+    program->setUniformValue(uniformLocation("TexInv"), texture_to_eye.inverted());
+    program->setUniformValueArray(uniformLocation("corners"), corners.data(), static_cast<int>(corners.size()));
+    program->setUniformValue(uniformLocation("firstDepth"), z_origin + first * step);
+    program->setUniformValue(uniformLocation("sliceDistance"), step);
+
+    // All slices are drawn by one call, from the farthest one; each instance is a fan of up to six vertices which
+    // slice.vert places on the polygon cut from the box, so the work on the CPU doesn't depend on the number of slices.
+    slice_vao->bind();
+    QOpenGLContext::currentContext()->extraFunctions()->glDrawArraysInstanced(
+        GL_TRIANGLE_FAN, 0, 6, static_cast<GLsizei>(last - first) + 1);
+    slice_vao->release();
 }
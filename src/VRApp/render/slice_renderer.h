@@ -2,9 +2,9 @@
 
 #include "renderer.h"
 
-#include <memory>
+#include <QOpenGLVertexArrayObject>
 
-class Plane;
+#include <memory>
 
 class SliceRenderer : public Renderer {
 public:
@@ -17,5 +17,6 @@ protected:
 
 private:
     QMatrix4x4 texture_matrix;
-    std::shared_ptr<Plane> plane;
+    // Slice polygons are made in the vertex shader, which needs no attributes; the core profile still wants a bound array.
+    std::unique_ptr<QOpenGLVertexArrayObject> slice_vao;
 };
@@ -0,0 +1,31 @@
+#include "texture_pool.h"
+
+#include <algorithm>
+
+TexturePool::TexturePtr TexturePool::acquire(int width, int height, int depth, QOpenGLTexture::TextureFormat format, int mip_levels) {
+    auto it = std::find_if(textures.rbegin(), textures.rend(), [&](const TexturePtr &tex) {
+        return tex->width() == width && tex->height() == height && tex->depth() == depth && tex->format() == format &&
+               tex->mipLevels() == mip_levels;
+    });
+    if (it != textures.rend()) {
+        auto tex = *it;
+        textures.erase(std::next(it).base());
+        return tex;
+    }
+    auto tex = std::make_shared<QOpenGLTexture>(QOpenGLTexture::Target3D);
+    tex->setSize(width, height, depth);
+    tex->setFormat(format);
+    tex->setMipLevels(mip_levels);
+    tex->allocateStorage();
+    return tex;
+}
+
+void TexturePool::recycle(TexturePtr texture) {
+    if (!texture || !texture->isStorageAllocated()) {
+        return;
+    }
+    textures.push_back(texture);
+    if (textures.size() > capacity) {
+        textures.erase(textures.begin());
+    }
+}
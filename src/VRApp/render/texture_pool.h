@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QOpenGLTexture>
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/*
+ * Small pool of 3D textures with allocated storage, keyed by size, format and number of mip levels.
+ * Lets same-sized volumes (e.g. time steps) reuse storage instead of reallocating it.
+ * All methods should be called with the GL context current.
+ */
+class TexturePool {
+public:
+    using TexturePtr = std::shared_ptr<QOpenGLTexture>;
+
+    explicit TexturePool(size_t capacity = 2) :
+        capacity(capacity)
+    {
+    }
+
+    // Texture with allocated storage of the given size, format and number of mip levels: from the pool, or a new one.
+    TexturePtr acquire(int width, int height, int depth, QOpenGLTexture::TextureFormat format, int mip_levels = 1);
+
+    // Return the texture into the pool for reuse; the least recently returned one is destroyed if the pool is full.
+    void recycle(TexturePtr texture);
+
+    void clear() {
+        textures.clear();
+    }
+
+private:
+    size_t capacity;
+    std::vector<TexturePtr> textures; // most recently returned textures are at the end
+};
@@ -0,0 +1,148 @@
+#include "texture_uploader.h"
+
+#include <QOpenGLContext>
+
+#include <algorithm>
+#include <cstring>
+
+TextureUploader::TextureUploader(size_t num_of_buffers, size_t slab_bytes) :
+    num_of_buffers(std::max(num_of_buffers, size_t(1))),
+    slab_bytes(slab_bytes)
+{
+}
+
+void TextureUploader::initSlots() {
+    if (!slots.empty()) {
+        return;
+    }
+    slots.resize(num_of_buffers);
+    for (auto &slot: slots) {
+        slot.buffer = std::make_unique<QOpenGLBuffer>(QOpenGLBuffer::PixelUnpackBuffer);
+        slot.buffer->setUsagePattern(QOpenGLBuffer::StreamDraw);
+        slot.buffer->create();
+    }
+}
+
+void TextureUploader::start(QOpenGLTexture *tex, std::shared_ptr<const void> data_holder, const void *tex_data, size_t bytes_per_texel,
+                            QOpenGLTexture::PixelFormat pixel_format, QOpenGLTexture::PixelType pixel_type,
+                            int first, int last, int mip_level) {
+    cancel();
+    initSlots();
+    texture = tex;
+    holder = data_holder;
+    data = static_cast<const unsigned char *>(tex_data);
+    texel_bytes = bytes_per_texel;
+    format = pixel_format;
+    type = pixel_type;
+    level = mip_level;
+    level_width = std::max(texture->width() >> level, 1);
+    level_height = std::max(texture->height() >> level, 1);
+    const auto level_depth = std::max(texture->depth() >> level, 1);
+    const auto slice_bytes = static_cast<size_t>(level_width * level_height) * texel_bytes;
+    slices_per_slab = static_cast<int>(std::max(slab_bytes / slice_bytes, size_t(1)));
+    first_slice = std::max(first, 0);
+    end_slice = (last < 0 ? level_depth : std::min(last, level_depth));
+    next_slice = first_slice;
+}
+
+bool TextureUploader::uploadSlab(QOpenGLExtraFunctions *gl, Slot &slot, bool wait) {
+    if (slot.fence) {
+        // Buffer can be overwritten only when the GPU has finished reading from it.
+        const auto status = gl->glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+                                                 wait ? GL_TIMEOUT_IGNORED : 0);
+        if (status == GL_TIMEOUT_EXPIRED) {
+            return false;
+        }
+        gl->glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+    }
+
+    const auto width = level_width;
+    const auto height = level_height;
+    const auto num_of_slices = std::min(slices_per_slab, end_slice - next_slice);
+    const auto slice_bytes = static_cast<size_t>(width * height) * texel_bytes;
+    const auto bytes = static_cast<int>(slice_bytes * static_cast<size_t>(num_of_slices));
+
+    slot.buffer->bind();
+    if (slot.buffer->size() < bytes) {
+        slot.buffer->allocate(bytes);
+    }
+    auto *dest = slot.buffer->mapRange(0, bytes, QOpenGLBuffer::RangeWrite | QOpenGLBuffer::RangeInvalidateBuffer);
+    if (!dest) {
+        slot.buffer->release();
+        return false;
+    }
+    std::memcpy(dest, data + slice_bytes * static_cast<size_t>(next_slice), static_cast<size_t>(bytes));
+    slot.buffer->unmap();
+
+    texture->bind();
+    // Source is the bound unpack buffer, so the data pointer is an offset in it.
+    gl->glTexSubImage3D(GL_TEXTURE_3D, level, 0, 0, next_slice, width, height, num_of_slices,
+                        static_cast<GLenum>(format), static_cast<GLenum>(type), nullptr);
+    texture->release();
+    slot.buffer->release();
+
+    slot.fence = gl->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    next_slice += num_of_slices;
+    return true;
+}
+
+bool TextureUploader::process(size_t byte_budget) {
+    if (!isActive()) {
+        return true;
+    }
+    auto *gl = QOpenGLContext::currentContext()->extraFunctions();
+    const auto slice_bytes = static_cast<size_t>(level_width * level_height) * texel_bytes;
+    size_t uploaded = 0;
+    while (next_slice < end_slice && (uploaded == 0 || uploaded < byte_budget)) {
+        if (!uploadSlab(gl, slots[next_slot], false)) {
+            break; // all buffers are still in use, continue on the next call
+        }
+        uploaded += slice_bytes * static_cast<size_t>(slices_per_slab);
+        next_slot = (next_slot + 1) % slots.size();
+    }
+    if (next_slice >= end_slice) {
+        texture = nullptr;
+        holder.reset();
+        return true;
+    }
+    return false;
+}
+
+void TextureUploader::finish() {
+    if (!isActive()) {
+        return;
+    }
+    auto *gl = QOpenGLContext::currentContext()->extraFunctions();
+    while (next_slice < end_slice) {
+        uploadSlab(gl, slots[next_slot], true);
+        next_slot = (next_slot + 1) % slots.size();
+    }
+    texture = nullptr;
+    holder.reset();
+}
+
+void TextureUploader::cancel() {
+    texture = nullptr;
+    holder.reset();
+    first_slice = next_slice = end_slice = 0;
+}
+
+float TextureUploader::progress() const {
+    if (!isActive() || end_slice <= first_slice) {
+        return 1.0f;
+    }
+    return static_cast<float>(next_slice - first_slice) / static_cast<float>(end_slice - first_slice);
+}
+
+void TextureUploader::release() {
+    cancel();
+    auto *ctx = QOpenGLContext::currentContext();
+    for (auto &slot: slots) {
+        if (slot.fence && ctx) {
+            ctx->extraFunctions()->glDeleteSync(slot.fence);
+        }
+        slot.buffer->destroy();
+    }
+    slots.clear();
+}
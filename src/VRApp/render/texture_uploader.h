@@ -0,0 +1,70 @@
+#pragma once
+
+#include <QOpenGLBuffer>
+#include <QOpenGLTexture>
+#include <QOpenGLExtraFunctions>
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/*
+ * Uploads 3D texture data in z-slabs through a ring of pixel buffer objects.
+ * Each call of process() uploads only a limited amount of bytes, so a large volume
+ * is spread over several frames instead of stalling one of them.
+ * All methods should be called with the GL context current.
+ */
+class TextureUploader {
+public:
+    TextureUploader(size_t num_of_buffers = 3, size_t slab_bytes = 16*1024*1024);
+    ~TextureUploader() = default;
+
+    // Start uploading data into the mip level of the texture (which storage should be allocated).
+    // Data is laid out as depth slices of width*height texels of the level; 'holder' keeps it alive during the upload.
+    // Only slices [first_slice, last_slice) are uploaded; negative last slice means the level depth.
+    void start(QOpenGLTexture *texture, std::shared_ptr<const void> holder, const void *data, size_t texel_bytes,
+               QOpenGLTexture::PixelFormat format, QOpenGLTexture::PixelType type,
+               int first_slice = 0, int last_slice = -1, int level = 0);
+
+    // Upload next slabs, at most 'byte_budget' bytes (but at least one slab). Returns true if the upload is complete.
+    bool process(size_t byte_budget);
+
+    // Upload everything that is left at once.
+    void finish();
+
+    void cancel();
+
+    bool isActive() const {
+        return texture != nullptr;
+    }
+
+    // Part of the data which has been uploaded, in [0, 1].
+    float progress() const;
+
+    // Free GL objects.
+    void release();
+
+private:
+    struct Slot {
+        std::unique_ptr<QOpenGLBuffer> buffer;
+        GLsync fence = nullptr; // signaled when the last upload from the buffer is complete
+    };
+
+    bool uploadSlab(QOpenGLExtraFunctions *gl, Slot &slot, bool wait);
+    void initSlots();
+
+private:
+    size_t num_of_buffers, slab_bytes;
+    std::vector<Slot> slots;
+    size_t next_slot {0};
+
+    QOpenGLTexture *texture = nullptr;
+    std::shared_ptr<const void> holder;
+    const unsigned char *data = nullptr;
+    size_t texel_bytes {0};
+    QOpenGLTexture::PixelFormat format;
+    QOpenGLTexture::PixelType type;
+    int slices_per_slab {1};
+    int level {0}, level_width {0}, level_height {0};
+    int first_slice {0}, next_slice {0}, end_slice {0};
+};
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QVector3D>
+
+#include <cstring>
+
+// std140 layouts of the uniform blocks of volume shaders (see FrameState and VolumeState in raycast.frag).
+
+// State which changes with the camera and the level of detail.
+struct FrameUniforms {
+    GLfloat eye_position[3];
+    GLfloat step;
+    GLfloat light_position[3];
+    GLfloat step_mult_coeff;
+    GLfloat lod;
+    GLint num_steps;
+    GLint jitter_size;
+    GLint padding;
+};
+
+// State which changes only with the volume or its classification.
+struct VolumeUniforms {
+    GLfloat brick_size[3];
+    GLfloat page_size;
+    GLfloat volume_size[3];
+    GLfloat atlas_size;
+    GLint preintegration_size;
+    GLint num_channels; // extra ones
+    GLint padding[2];
+};
+
+static_assert(sizeof(FrameUniforms) == 48, "FrameUniforms doesn't match std140 layout");
+static_assert(sizeof(VolumeUniforms) == 48, "VolumeUniforms doesn't match std140 layout");
+
+inline void setVec3(GLfloat *dst, const QVector3D &v) {
+    dst[0] = v.x();
+    dst[1] = v.y();
+    dst[2] = v.z();
+}
+
+/*
+ * Uniform buffer object with a CPU copy of its block. Changes go to the copy, and upload() sends it
+ * to the buffer only if it differs from what has been sent before, so unchanged state costs a memcmp.
+ * The buffer is bound to a fixed binding point, which programs assign to the block by its name.
+ * Methods should be called with the GL context current.
+ */
+template <typename Block>
+class UniformBuffer {
+public:
+    explicit UniformBuffer(GLuint binding) :
+        binding(binding)
+    {
+        std::memset(&block, 0, sizeof(Block));
+        std::memset(&uploaded, 0, sizeof(Block));
+    }
+
+    ~UniformBuffer() {
+        if (buffer != 0 && QOpenGLContext::currentContext()) {
+            QOpenGLContext::currentContext()->extraFunctions()->glDeleteBuffers(1, &buffer);
+        }
+    }
+
+    UniformBuffer(const UniformBuffer &) = delete;
+    UniformBuffer &operator=(const UniformBuffer &) = delete;
+
+    Block &data() {
+        return block;
+    }
+
+    GLuint bindingPoint() const {
+        return binding;
+    }
+
+    void upload(QOpenGLExtraFunctions *gl) {
+        if (buffer == 0) {
+            gl->glGenBuffers(1, &buffer);
+            gl->glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+            gl->glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), &block, GL_DYNAMIC_DRAW);
+            uploaded = block;
+        } else if (std::memcmp(&block, &uploaded, sizeof(Block)) != 0) {
+            gl->glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+            gl->glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block);
+            uploaded = block;
+        }
+        gl->glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        // Binding points are shared by renderers, so the buffer is bound again on each upload.
+        gl->glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+    }
+
+private:
+    GLuint binding;
+    GLuint buffer = 0;
+    Block block;
+    Block uploaded;
+};
@@ -0,0 +1,134 @@
+#include "volume_texture.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+size_t levelSize(size_t size, size_t level) {
+    return std::max(size >> level, size_t(1));
+}
+
+}
+
+VolumeTexture::VolumeTexture(QOpenGLTexture::TextureFormat format, QOpenGLTexture::PixelFormat pixel_format,
+                             QOpenGLTexture::PixelType pixel_type, size_t texel_bytes) :
+    format(format),
+    pixel_format(pixel_format),
+    pixel_type(pixel_type),
+    texel_bytes(texel_bytes)
+{
+}
+
+void VolumeTexture::setData(std::shared_ptr<const void> holder, std::vector<const void *> levels,
+                            size_t width, size_t height, size_t depth) {
+    pending_data = holder;
+    pending_levels = std::move(levels);
+    pending_width = width;
+    pending_height = height;
+    pending_depth = depth;
+    pending_slab.reset();
+}
+
+void VolumeTexture::updateSlab(std::shared_ptr<const void> holder, std::vector<const void *> levels,
+                               size_t width, size_t height, size_t depth, size_t z_begin, size_t z_end) {
+    // The slab goes into the texture which is being uploaded or shown; without one of the same size,
+    // or if the whole data is going to be uploaded anyway, the whole data is uploaded.
+    const auto &target = (loading ? loading : current);
+    if (pending_data || !target || target->width() != static_cast<int>(width) ||
+            target->height() != static_cast<int>(height) || target->depth() != static_cast<int>(depth)) {
+        setData(holder, std::move(levels), width, height, depth);
+        return;
+    }
+    if (pending_slab) {
+        // Merge with the slab which has not been uploaded yet.
+        z_begin = std::min(z_begin, pending_slab_begin);
+        z_end = std::max(z_end, pending_slab_end);
+    }
+    pending_slab = holder;
+    pending_levels = std::move(levels);
+    pending_slab_begin = z_begin;
+    pending_slab_end = z_end;
+}
+
+void VolumeTexture::startLevel() {
+    const auto &range = upload_ranges[upload_level];
+    uploader.start(loading.get(), upload_holder, upload_levels[upload_level], texel_bytes, pixel_format, pixel_type,
+                   static_cast<int>(range.first), static_cast<int>(range.second), static_cast<int>(upload_level));
+}
+
+bool VolumeTexture::process(size_t byte_budget) {
+    if (pending_data) {
+        uploader.cancel();
+        if (loading != current) {
+            texture_pool.recycle(loading);
+        }
+        // New texture is filled while the current one is still rendered.
+        // Storage of a previous texture of the same size is reused if there is one.
+        const auto mip_levels = static_cast<int>(pending_levels.size());
+        loading = texture_pool.acquire(static_cast<int>(pending_width), static_cast<int>(pending_height),
+                                       static_cast<int>(pending_depth), format, mip_levels);
+        loading->setMinMagFilters(mip_levels > 1 ? QOpenGLTexture::LinearMipMapLinear : QOpenGLTexture::Linear,
+                                  QOpenGLTexture::Linear);
+        loading->setMipMaxLevel(mip_levels - 1);
+        loading->setWrapMode(QOpenGLTexture::ClampToEdge);
+        loading->setMaximumAnisotropy(16.0f);
+        loading->setBorderColor(0.0f, 0.0f, 0.0f, 0.0f);
+        upload_holder = pending_data;
+        upload_levels = pending_levels;
+        upload_ranges.clear();
+        for (size_t level = 0; level < upload_levels.size(); level++) {
+            upload_ranges.emplace_back(0, levelSize(pending_depth, level));
+        }
+        upload_level = 0;
+        startLevel();
+        pending_data.reset();
+    } else if (pending_slab && !uploader.isActive() && current) {
+        // Only changed slices (and slices of coarser levels which cover them) are uploaded into the current texture.
+        loading = current;
+        upload_holder = pending_slab;
+        upload_levels = pending_levels;
+        upload_levels.resize(std::min(upload_levels.size(), static_cast<size_t>(current->mipLevels())));
+        upload_ranges.clear();
+        auto z_begin = pending_slab_begin;
+        auto z_end = std::min(pending_slab_end, static_cast<size_t>(current->depth()));
+        auto depth = static_cast<size_t>(current->depth());
+        for (size_t level = 0; level < upload_levels.size(); level++) {
+            const auto level_depth = levelSize(static_cast<size_t>(current->depth()), level);
+            if (level > 0) {
+                const auto ratio = static_cast<double>(depth) / static_cast<double>(level_depth);
+                z_begin = static_cast<size_t>(std::floor(static_cast<double>(z_begin) / ratio));
+                z_end = std::min(static_cast<size_t>(std::ceil(static_cast<double>(z_end) / ratio)), level_depth);
+            }
+            upload_ranges.emplace_back(z_begin, z_end);
+            depth = level_depth;
+        }
+        upload_level = 0;
+        startLevel();
+        pending_slab.reset();
+    }
+    if (!uploader.isActive() || !uploader.process(byte_budget)) {
+        return false;
+    }
+    if (++upload_level < upload_levels.size()) {
+        startLevel();
+        return false;
+    }
+    upload_holder.reset();
+    if (loading != current) {
+        texture_pool.recycle(current);
+        current = loading;
+    }
+    loading.reset();
+    return true;
+}
+
+void VolumeTexture::release() {
+    uploader.release();
+    pending_data.reset();
+    pending_slab.reset();
+    upload_holder.reset();
+    current.reset();
+    loading.reset();
+    texture_pool.clear();
+}
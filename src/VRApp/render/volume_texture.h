@@ -0,0 +1,113 @@
+#pragma once
+
+#include "texture_pool.h"
+#include "texture_uploader.h"
+#include "frame3d.h"
+
+#include <QOpenGLTexture>
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/*
+ * 3D texture which contents are streamed from frames by the uploader.
+ * A new frame is uploaded into another texture while the current one is still shown;
+ * a slab update of the same-sized frame is uploaded in place.
+ * Optionally the frame comes with a pyramid of coarser levels, which are uploaded as mip levels.
+ * Methods which touch GL objects (process, release) should be called with the GL context current.
+ */
+class VolumeTexture {
+public:
+    VolumeTexture(QOpenGLTexture::TextureFormat format, QOpenGLTexture::PixelFormat pixel_format,
+                  QOpenGLTexture::PixelType pixel_type, size_t texel_bytes);
+    ~VolumeTexture() = default;
+
+    template <typename T>
+    void setFrame(std::shared_ptr<const Frame3D<T>> frame) {
+        setData(frame, {frame->data()}, frame->width(), frame->height(), frame->depth());
+    }
+
+    // Pyramid holds levels 1, 2, ... with sizes max(1, size/2) of the previous level, down to 1x1x1.
+    template <typename T>
+    void setFrame(std::shared_ptr<const Frame3D<T>> frame, std::shared_ptr<const std::vector<Frame3D<T>>> pyramid) {
+        setData(std::make_shared<std::pair<decltype(frame), decltype(pyramid)>>(frame, pyramid),
+                levelsOf(*frame, *pyramid), frame->width(), frame->height(), frame->depth());
+    }
+
+    // Frame should differ from the previous one only in slices [z_begin, z_end), which are uploaded;
+    // if there is no texture of the same size to update, the whole frame is.
+    template <typename T>
+    void updateFrameSlab(std::shared_ptr<const Frame3D<T>> frame, size_t z_begin, size_t z_end) {
+        updateSlab(frame, {frame->data()}, frame->width(), frame->height(), frame->depth(), z_begin, z_end);
+    }
+
+    // Slices of coarser levels which cover slices [z_begin, z_end) of the frame are uploaded too.
+    template <typename T>
+    void updateFrameSlab(std::shared_ptr<const Frame3D<T>> frame, std::shared_ptr<const std::vector<Frame3D<T>>> pyramid,
+                         size_t z_begin, size_t z_end) {
+        updateSlab(std::make_shared<std::pair<decltype(frame), decltype(pyramid)>>(frame, pyramid),
+                   levelsOf(*frame, *pyramid), frame->width(), frame->height(), frame->depth(), z_begin, z_end);
+    }
+
+    // Data of mip levels (level 0 first) is laid out as depth slices of width*height texels of the level;
+    // 'holder' keeps it alive during the upload.
+    void setData(std::shared_ptr<const void> holder, std::vector<const void *> levels, size_t width, size_t height, size_t depth);
+    void updateSlab(std::shared_ptr<const void> holder, std::vector<const void *> levels, size_t width, size_t height, size_t depth,
+                    size_t z_begin, size_t z_end);
+
+    // Upload at most 'byte_budget' bytes. Returns true if texture() has been replaced or updated.
+    bool process(size_t byte_budget);
+
+    // True if there is something left to upload.
+    bool isUploading() const {
+        return uploader.isActive() || pending_data || pending_slab;
+    }
+
+    // Part of the data which has been uploaded, in [0, 1]: coarser levels are small, so only level 0 is counted.
+    float progress() const {
+        return (upload_level == 0 ? uploader.progress() : 1.0f);
+    }
+
+    // Texture with the last completely uploaded data.
+    QOpenGLTexture* texture() const {
+        return current.get();
+    }
+
+    // Drop the data and free GL objects.
+    void release();
+
+private:
+    template <typename T>
+    static std::vector<const void *> levelsOf(const Frame3D<T> &frame, const std::vector<Frame3D<T>> &pyramid) {
+        std::vector<const void *> levels {frame.data()};
+        for (const auto &level: pyramid) {
+            levels.push_back(level.data());
+        }
+        return levels;
+    }
+
+    void startLevel();
+
+private:
+    QOpenGLTexture::TextureFormat format;
+    QOpenGLTexture::PixelFormat pixel_format;
+    QOpenGLTexture::PixelType pixel_type;
+    size_t texel_bytes;
+
+    std::shared_ptr<const void> pending_data, pending_slab;
+    std::vector<const void *> pending_levels;
+    size_t pending_width {0}, pending_height {0}, pending_depth {0};
+    size_t pending_slab_begin {0}, pending_slab_end {0};
+
+    // Levels which are being uploaded, with slices [begin, end) of each one.
+    std::shared_ptr<const void> upload_holder;
+    std::vector<const void *> upload_levels;
+    std::vector<std::pair<size_t, size_t>> upload_ranges;
+    size_t upload_level {0};
+
+    std::shared_ptr<QOpenGLTexture> current, loading;
+    TexturePool texture_pool;
+    TextureUploader uploader;
+};
@@ -0,0 +1,62 @@
+#-------------------------------------------------
+#
+# Data loading and GL rendering code shared by VRApp and VRBatch
+#
+#-------------------------------------------------
+
+# Includes are relative to the VRApp directory.
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/brick_residency.cpp \
+    $$PWD/brick_volume.cpp \
+    $$PWD/cube/cube_data.cpp \
+    $$PWD/cube/cube_util.cpp \
+    $$PWD/distance_transform.cpp \
+    $$PWD/frame_loader.cpp \
+    $$PWD/frame_util.cpp \
+    $$PWD/gradient_volume.cpp \
+    $$PWD/objects/cube.cpp \
+    $$PWD/objects/triangulated_shape.cpp \
+    $$PWD/palette_util.cpp \
+    $$PWD/render/brick_atlas.cpp \
+    $$PWD/render/frame_profiler.cpp \
+    $$PWD/render/ray_cast_renderer.cpp \
+    $$PWD/render/renderer.cpp \
+    $$PWD/render/shader_variants.cpp \
+    $$PWD/render/texture_pool.cpp \
+    $$PWD/render/texture_uploader.cpp \
+    $$PWD/render/volume_texture.cpp \
+    $$PWD/transfer_function.cpp \
+    $$PWD/volume_pyramid.cpp \
+    $$PWD/volume_source.cpp
+
+HEADERS += \
+    $$PWD/../common/types.h \
+    $$PWD/brick_residency.h \
+    $$PWD/brick_volume.h \
+    $$PWD/cube/cube_data.h \
+    $$PWD/cube/cube_util.h \
+    $$PWD/distance_transform.h \
+    $$PWD/frame3d.h \
+    $$PWD/frame_loader.h \
+    $$PWD/frame_util.h \
+    $$PWD/gradient_volume.h \
+    $$PWD/objects/buffer.h \
+    $$PWD/objects/cube.h \
+    $$PWD/objects/shape.h \
+    $$PWD/objects/triangulated_shape.h \
+    $$PWD/palette_util.h \
+    $$PWD/philox.h \
+    $$PWD/render/brick_atlas.h \
+    $$PWD/render/frame_profiler.h \
+    $$PWD/render/ray_cast_renderer.h \
+    $$PWD/render/renderer.h \
+    $$PWD/render/shader_variants.h \
+    $$PWD/render/texture_pool.h \
+    $$PWD/render/texture_uploader.h \
+    $$PWD/render/uniform_buffer.h \
+    $$PWD/render/volume_texture.h \
+    $$PWD/transfer_function.h \
+    $$PWD/volume_pyramid.h \
+    $$PWD/volume_source.h
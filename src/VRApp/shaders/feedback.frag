@@ -0,0 +1,118 @@
+#version 330
+
+in vec3 coord;
+
+// Ids (plus one, zero means none) of bricks of the virtual texture which the ray needs, packed into bytes.
+layout(location = 0) out vec4 missingBrick; // first missing brick along the ray
+layout(location = 1) out vec4 usedBrick; // random resident brick which the ray has sampled
+
+uniform sampler3D texture3d; // brick atlas
+uniform sampler1D transferFunction; // color (rgb) and opacity (a) with the cutoff window applied
+
+uniform vec3 eyePosition;
+
+uniform float step;
+uniform float stepMultCoeff;
+uniform int numSteps;
+
+uniform sampler3D occupancy; // zero for empty bricks, otherwise step scale of the brick (divided by 255)
+uniform vec3 brickSize; // in texture coordinates
+uniform bool skippingEnabled;
+
+uniform vec3 boxMin, boxMax; // proxy box in texture coordinates
+
+uniform usampler3D pageTable; // atlas slot (rgb) and residency (a) of each brick of the virtual texture
+uniform bool virtualEnabled; // texture3d is the brick atlas
+uniform vec3 volumeSize; // in voxels
+uniform float pageSize; // size of a brick of the virtual texture in voxels, without the apron
+uniform float atlasSize; // in texels
+uniform vec3 pageTableSize;
+uniform float frameIndex; // varies the choice of used bricks between frames
+
+ivec3 pageOf(vec3 coord) {
+    return clamp(ivec3(coord * volumeSize / pageSize), ivec3(0), ivec3(pageTableSize) - ivec3(1));
+}
+
+vec4 encodeBrick(ivec3 page) {
+    uint id = uint(page.x + int(pageTableSize.x) * (page.y + int(pageTableSize.y) * page.z)) + 1u;
+    return vec4(uvec4(id & 255u, (id >> 8u) & 255u, (id >> 16u) & 255u, id >> 24u)) / 255.0;
+}
+
+float getValue(vec3 coord, ivec3 page, uvec4 entry) {
+    vec3 voxel = clamp(coord, vec3(0.0), vec3(1.0)) * volumeSize;
+    vec3 atlasVoxel = vec3(entry.rgb) * (pageSize + 2.0) + vec3(1.0) + voxel - vec3(page) * pageSize;
+    return textureLod(texture3d, atlasVoxel / atlasSize, 0.0).r;
+}
+
+float random(float n) {
+    return fract(sin(dot(vec3(gl_FragCoord.xy, frameIndex + n), vec3(12.9898, 78.233, 37.719))) * 43758.5453);
+}
+
+float brickStepScale(vec3 pos) {
+    ivec3 brick = clamp(ivec3(pos / brickSize), ivec3(0), textureSize(occupancy, 0) - ivec3(1));
+    return floor(texelFetch(occupancy, brick, 0).r * 255.0 + 0.5);
+}
+
+float brickExitDistance(vec3 pos, vec3 dir, vec3 size) {
+    vec3 brickMin = floor(pos / size) * size;
+    vec3 exitPlane = brickMin + vec3(greaterThan(dir, vec3(0.0))) * size;
+    vec3 dist = abs(exitPlane - pos) / max(abs(dir), vec3(1e-6));
+    return min(dist.x, min(dist.y, dist.z));
+}
+
+vec2 intersectBox(vec3 origin, vec3 dir) {
+    vec3 invDir = 1.0 / dir;
+    vec3 t0 = (boxMin - origin) * invDir;
+    vec3 t1 = (boxMax - origin) * invDir;
+    vec3 tNear = min(t0, t1);
+    vec3 tFar = max(t0, t1);
+    return vec2(max(max(tNear.x, tNear.y), tNear.z), min(min(tFar.x, tFar.y), tFar.z));
+}
+
+// Same ray as in raycast.frag, but only opacity is accumulated: bricks behind opaque ones are not needed.
+void main() {
+    vec3 texCoord = (coord + vec3(1.0)) * 0.5;
+    vec3 eye = (eyePosition + vec3(1.0)) * 0.5;
+    vec3 direction = normalize(texCoord - eye);
+
+    vec2 span = intersectBox(eye, direction);
+    float dist = max(span.x, 0.0);
+    float exit = max(span.y, dist);
+
+    missingBrick = vec4(0.0);
+    usedBrick = vec4(0.0);
+    float alpha = 0.0;
+    float numOfUsed = 0.0;
+    ivec3 lastPage = ivec3(-1);
+
+    for (int i = 0; i < numSteps && dist < exit; i++) {
+        vec3 position = eye + direction * dist;
+
+        if (skippingEnabled && brickStepScale(position) == 0.0) {
+            dist += step * max(ceil(brickExitDistance(position, direction, brickSize) / step), 1.0);
+            continue;
+        }
+
+        ivec3 page = pageOf(position);
+        uvec4 entry = texelFetch(pageTable, page, 0);
+        if (entry.a == 0u) {
+            missingBrick = encodeBrick(page);
+            break;
+        }
+        if (page != lastPage) {
+            // Reservoir sampling: each brick along the ray is reported with equal probability.
+            numOfUsed += 1.0;
+            if (random(numOfUsed) * numOfUsed < 1.0) {
+                usedBrick = encodeBrick(page);
+            }
+            lastPage = page;
+        }
+
+        float a = texture(transferFunction, getValue(position, page, entry)).a;
+        alpha += (1.0 - alpha) * (1.0 - pow(max(1.0 - a, 0.0), stepMultCoeff));
+        if (alpha > 0.99) {
+            break;
+        }
+        dist += step;
+    }
+}
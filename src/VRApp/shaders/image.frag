@@ -0,0 +1,12 @@
+#version 330
+
+in vec2 texCoord;
+
+out vec4 fragColor;
+
+uniform sampler2D image; // rendered on the CPU, a texel per pixel
+
+void main()
+{
+    fragColor = texture(image, texCoord);
+}
@@ -0,0 +1,12 @@
+#version 330
+
+in vec2 vertex;
+
+out vec2 texCoord;
+
+void main()
+{
+    // Quad covers the viewport.
+    gl_Position = vec4(vertex, 0.0, 1.0);
+    texCoord = vertex * 0.5 + vec2(0.5);
+}
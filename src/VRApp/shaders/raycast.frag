@@ -5,33 +5,99 @@ in vec3 coord;
 out vec4 fragColor;
 
 uniform sampler3D texture3d;
-uniform sampler1D palette;
-uniform sampler1D opacity;
-
+uniform sampler1D transferFunction; // color (rgb) and opacity (a) with the cutoff window applied
 uniform sampler2D jitter;
-uniform int jitterSize;
-uniform bool jitterEnabled;
+uniform sampler3D gradientTexture; // normal (rgb) packed into [0, 1] and square root of magnitude (a)
+uniform sampler3D occupancy; // zero for empty bricks, otherwise step scale of the brick (divided by 255)
+uniform usampler3D pageTable; // atlas slot (rgb) and residency (a) of each brick of the virtual texture
+uniform sampler2D preintegrated;
+uniform sampler3D channels; // extra channels of co-registered volumes packed into components
+uniform sampler2D channelFunctions; // transfer function of each extra channel in its row
+
+uniform vec3 boxMin, boxMax; // proxy box in texture coordinates
 
-uniform float cutoffLow, cutoffHigh, cutoffCoeff;
+// Per-frame state, shared by all volume shaders (see FrameUniforms in render/uniform_buffer.h).
+layout(std140) uniform FrameState {
+    vec3 eyePosition;
+    float step;
+    vec3 lightPosition;
+    float stepMultCoeff;
+    float lod; // mip level to sample
+    int numSteps;
+    int jitterSize;
+};
 
-uniform vec3 eyePosition;
-uniform vec3 lightPosition;
-uniform bool lightingEnabled;
+// State which changes only with the volume or its classification (see VolumeUniforms in render/uniform_buffer.h).
+layout(std140) uniform VolumeState {
+    vec3 brickSize; // of empty space skipping, in texture coordinates
+    float pageSize; // size of a brick of the virtual texture in voxels, without the apron
+    vec3 volumeSize; // in voxels
+    float atlasSize; // in texels
+    int preintegrationSize;
+    int numChannels; // extra ones
+};
 
-uniform float step;
-uniform float stepMultCoeff;
-uniform int numSteps;
+// Page table entry of the brick which contains the position.
+uvec4 pageEntry(vec3 coord) {
+    ivec3 page = clamp(ivec3(coord * volumeSize / pageSize), ivec3(0), textureSize(pageTable, 0) - ivec3(1));
+    return texelFetch(pageTable, page, 0);
+}
+
+// Features are enabled by defines injected into the source of each program variant:
+// CHANNELS, LIGHTING, JITTER, PREINTEGRATION, GRADIENT, SKIPPING and VIRTUAL_TEXTURE (texture3d is the brick atlas).
+
+bool isResident(vec3 coord) {
+#ifdef VIRTUAL_TEXTURE
+    return pageEntry(coord).a != 0u;
+#else
+    return true;
+#endif
+}
 
 float getValue(vec3 coord) {
-    return texture(texture3d, coord).r;
+#ifdef VIRTUAL_TEXTURE
+    vec3 voxel = clamp(coord, vec3(0.0), vec3(1.0)) * volumeSize;
+    ivec3 page = clamp(ivec3(voxel / pageSize), ivec3(0), textureSize(pageTable, 0) - ivec3(1));
+    uvec4 entry = texelFetch(pageTable, page, 0);
+    if (entry.a == 0u) {
+        return 0.0; // missing bricks are not rendered, see isResident()
+    }
+    // Slot origin in the atlas, then the apron, then the position inside the brick.
+    vec3 atlasVoxel = vec3(entry.rgb) * (pageSize + 2.0) + vec3(1.0) + voxel - vec3(page) * pageSize;
+    return textureLod(texture3d, atlasVoxel / atlasSize, 0.0).r;
+#else
+    return textureLod(texture3d, coord, lod).r;
+#endif
+}
+
+vec4 classify(float value) {
+    return texture(transferFunction, value);
 }
 
-vec3 getColor(float value) {
-    return texture(palette, value).rgb;
+#ifdef CHANNELS
+// Extra channels classified at the position and mixed with the classified value of the data texture:
+// opacities combine like of matter at the same spot, colors are weighted by opacity.
+vec4 mixChannels(vec4 classified, vec3 coord) {
+    vec4 values = texture(channels, coord);
+    float transparency = 1.0 - classified.a;
+    vec3 weighted = classified.rgb * classified.a;
+    float weights = classified.a;
+    float rows = float(textureSize(channelFunctions, 0).y);
+    for (int c = 0; c < numChannels; c++) {
+        vec4 channel = texture(channelFunctions, vec2(values[c], (float(c) + 0.5) / rows));
+        transparency *= 1.0 - channel.a;
+        weighted += channel.rgb * channel.a;
+        weights += channel.a;
+    }
+    return vec4(weighted / max(weights, 1e-6), 1.0 - transparency);
 }
+#endif
 
-float getAlpha(float value) {
-    return texture(opacity, value).r;
+// Average opacity-weighted color (rgb) and opacity (a) over the ray segment between two values.
+vec4 getSegment(float front, float back) {
+    // Map values onto texel centers of the table.
+    vec2 coord = (vec2(front, back) * float(preintegrationSize - 1) + vec2(0.5)) / float(preintegrationSize);
+    return texture(preintegrated, coord);
 }
 
 vec3 shade(vec3 N, vec3 V, vec3 L) {
@@ -65,48 +131,141 @@ vec3 gradient(vec3 coord) {
     sample2.y = getValue(coord + vec3(0.0, delta, 0.0));
     sample1.z = getValue(coord - vec3(0.0, 0.0, delta));
     sample2.z = getValue(coord + vec3(0.0, 0.0, delta));
-    return normalize(sample2 - sample1);
+    vec3 diff = sample2 - sample1;
+    return (dot(diff, diff) > 0.0 ? normalize(diff) : vec3(0.0));
 }
 
-bool isOutOfVolume(vec3 pos) {
-    vec3 temp1 = sign(pos);
-    vec3 temp2 = sign(vec3(1.0) - pos);
-    float inside = dot(temp1, temp2);
-    return (inside < 3.0);
+// Zero where the value is uniform, so the sample isn't lit.
+vec3 normal(vec3 coord) {
+#ifdef GRADIENT
+    // One fetch of the precomputed gradient instead of six.
+    vec4 texel = texture(gradientTexture, coord);
+    if (texel.a < 0.5 / 255.0) {
+        return vec3(0.0);
+    }
+    vec3 N = texel.rgb * 2.0 - vec3(1.0);
+    return N / max(length(N), 1e-4);
+#else
+    return gradient(coord);
+#endif
+}
+
+vec3 illuminate(vec3 position, vec3 direction) {
+    vec3 currCoord = position * 2.0 - vec3(1.0); // currect coordinate in [-1,1] cube
+    vec3 N = normal(position);
+    vec3 L = normalize(lightPosition - currCoord); // direction to light
+    vec3 V = -direction; // direction to eye
+    return shade(N, V, L);
+}
+
+// Zero for an empty brick, otherwise how many base steps can be taken at once in the brick.
+float brickStepScale(vec3 pos) {
+    ivec3 brick = clamp(ivec3(pos / brickSize), ivec3(0), textureSize(occupancy, 0) - ivec3(1));
+    return floor(texelFetch(occupancy, brick, 0).r * 255.0 + 0.5);
+}
+
+// Opacity of a sample which stands for the given number of base steps (opacity correction).
+float correctAlpha(float alpha, float steps) {
+    return 1.0 - pow(max(1.0 - alpha, 0.0), stepMultCoeff * steps);
+}
+
+// Distance along the ray from the position to the exit from its brick of the given size.
+float brickExitDistance(vec3 pos, vec3 dir, vec3 size) {
+    vec3 brickMin = floor(pos / size) * size;
+    vec3 exitPlane = brickMin + vec3(greaterThan(dir, vec3(0.0))) * size;
+    vec3 dist = abs(exitPlane - pos) / max(abs(dir), vec3(1e-6));
+    return min(dist.x, min(dist.y, dist.z));
+}
+
+// Distances along the ray to the entry into the box and to the exit from it (slab test).
+vec2 intersectBox(vec3 origin, vec3 dir) {
+    vec3 invDir = 1.0 / dir;
+    vec3 t0 = (boxMin - origin) * invDir;
+    vec3 t1 = (boxMax - origin) * invDir;
+    vec3 tNear = min(t0, t1);
+    vec3 tFar = max(t0, t1);
+    return vec2(max(max(tNear.x, tNear.y), tNear.z), min(min(tFar.x, tFar.y), tFar.z));
 }
 
 void main() {
-    vec3 texCoord = (coord + vec3(1.0)) * 0.5;
-    vec3 position = texCoord; // current texture coords in the cube
-    vec3 direction = normalize(coord - eyePosition); // ray direction from eye
+    vec3 texCoord = (coord + vec3(1.0)) * 0.5; // exit point on the back face of the box
+    vec3 eye = (eyePosition + vec3(1.0)) * 0.5; // eye in texture coordinates
+    vec3 direction = normalize(texCoord - eye); // ray direction from eye
     vec4 dest = vec4(0.0);
 
-    if (jitterEnabled) {
-        float jitterCoeff = texture(jitter, gl_FragCoord.xy / vec2(jitterSize)).r;
-        position += direction * step * jitterCoeff;
-    }
+    // Ray starts at the box entry, or at the eye if it's inside the box.
+    vec2 span = intersectBox(eye, direction);
+    float entry = max(span.x, 0.0);
+    float exit = max(span.y, entry);
+
+#ifdef JITTER
+    float jitterCoeff = texture(jitter, gl_FragCoord.xy / vec2(jitterSize)).r;
+    entry += step * jitterCoeff;
+#endif
+
+    vec3 position = eye + direction * entry; // current texture coords in the cube
+    float dist = entry; // distance along the ray
+    float prevValue = getValue(position);
+
+#ifdef VIRTUAL_TEXTURE
+    vec3 pageExtent = vec3(pageSize) / volumeSize; // brick of the virtual texture in texture coordinates
+#endif
+
+    for (int i = 0; i < numSteps && dist < exit; i++) {
+        float stepScale = 1.0; // length of the current step in base steps
+
+#ifdef VIRTUAL_TEXTURE
+        if (!isResident(position)) {
+            // Missing brick of the virtual texture is skipped until it's paged in.
+            dist += step * max(ceil(brickExitDistance(position, direction, pageExtent) / step), 1.0);
+            position = eye + direction * dist;
+            prevValue = getValue(position);
+            continue;
+        }
+#endif
+
+#ifdef SKIPPING
+        float brickScale = brickStepScale(position);
+
+        if (brickScale == 0.0) {
+            // Leap to the first sample behind the empty brick.
+            dist += step * max(ceil(brickExitDistance(position, direction, brickSize) / step), 1.0);
+            position = eye + direction * dist;
+            prevValue = getValue(position);
+            continue;
+        }
+
+        // Long steps in homogeneous bricks, but not beyond the brick exit.
+        stepScale = clamp(floor(brickExitDistance(position, direction, brickSize) / step), 1.0, brickScale);
+#endif
 
-    for (int i = 0; i < numSteps; i++) {
         float value = getValue(position);
 
-        if (value >= cutoffLow && value <= cutoffHigh) {
-            value = (value - cutoffLow) * cutoffCoeff; // rescale value into cutoff range
+#ifdef PREINTEGRATION
+        // Classify the whole segment from the previous sample, so thin features are not missed between samples.
+        vec4 segment = getSegment(prevValue, value);
+        prevValue = value;
+        vec4 classified = vec4(segment.rgb / max(segment.a, 1e-6), segment.a); // opacity-weighted color is divided back
+#else
+        vec4 classified = classify(value); // values out of the cutoff window have zero opacity
+#endif
 
-            vec3 color = getColor(value);
-            float alpha = getAlpha(value) * stepMultCoeff;
+#ifdef CHANNELS
+        classified = mixChannels(classified, position);
+#endif
 
-            if (lightingEnabled && alpha > 0.05) {
-                vec3 currCoord = position * 2.0 - vec3(1.0); // currect coordinate in [-1,1] cube
-                vec3 N = gradient(position); // normal
-                vec3 L = normalize(lightPosition - currCoord); // direction to light
-                vec3 V = -direction; // direction to eye
+        float alpha = correctAlpha(classified.a, stepScale);
+        if (alpha > 0.0) {
+            vec3 color = classified.rgb;
 
-                color += shade(N, V, L);
+#ifdef LIGHTING
+            if (alpha > 0.05) {
+                color += illuminate(position, direction);
             }
+#endif
 
-            vec4 src = vec4(color * alpha, alpha);
             // Front-to-back compositing.
-            dest = (1.0 - dest.a) * src + dest;
+            dest = (1.0 - dest.a) * vec4(color * alpha, alpha) + dest;
         }
 
         // Early termination by alpha.
@@ -115,12 +274,8 @@ void main() {
         }
 
         // Advance ray position along ray direction.
-        position = position + direction * step;
-
-        // Check that we are inside the cube.
-        if (isOutOfVolume(position)) {
-            break;
-        }
+        dist += step * stepScale;
+        position = eye + direction * dist;
     }
     fragColor = dest;
 }
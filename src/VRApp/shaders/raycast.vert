@@ -5,9 +5,12 @@ in vec3 vertex;
 out vec3 coord;
 
 uniform mat4 MVP;
+uniform vec3 boxMin, boxMax; // proxy box in texture coordinates
 
 void main()
 {
-    gl_Position = MVP * vec4(vertex, 1.0f);
-    coord = vertex;
+    // Map the [-1,1] cube onto the proxy box.
+    vec3 boxVertex = mix(boxMin, boxMax, vertex * 0.5 + vec3(0.5)) * 2.0 - vec3(1.0);
+    gl_Position = MVP * vec4(boxVertex, 1.0f);
+    coord = boxVertex;
 }
@@ -5,32 +5,101 @@ in vec3 texCoord;
 out vec4 fragColor;
 
 uniform sampler3D texture3d;
-uniform sampler1D palette;
-uniform sampler1D opacity;
+uniform sampler1D transferFunction; // color (rgb) and opacity (a) with the cutoff window applied
+uniform sampler2D jitter;
+uniform sampler3D gradientTexture; // normal (rgb) packed into [0, 1] and square root of magnitude (a)
+uniform usampler3D pageTable; // atlas slot (rgb) and residency (a) of each brick of the virtual texture
+uniform sampler2D preintegrated;
+uniform sampler3D channels; // extra channels of co-registered volumes packed into components
+uniform sampler2D channelFunctions; // transfer function of each extra channel in its row
+
+// Per-frame state, shared by all volume shaders (see FrameUniforms in render/uniform_buffer.h).
+layout(std140) uniform FrameState {
+    vec3 eyePosition;
+    float step;
+    vec3 lightPosition;
+    float stepMultCoeff;
+    float lod; // mip level to sample
+    int numSteps;
+    int jitterSize;
+};
+
+// State which changes only with the volume or its classification (see VolumeUniforms in render/uniform_buffer.h).
+layout(std140) uniform VolumeState {
+    vec3 brickSize; // of empty space skipping, in texture coordinates
+    float pageSize; // size of a brick of the virtual texture in voxels, without the apron
+    vec3 volumeSize; // in voxels
+    float atlasSize; // in texels
+    int preintegrationSize;
+    int numChannels; // extra ones
+};
+
+// Page table entry of the brick which contains the position.
+uvec4 pageEntry(vec3 coord) {
+    ivec3 page = clamp(ivec3(coord * volumeSize / pageSize), ivec3(0), textureSize(pageTable, 0) - ivec3(1));
+    return texelFetch(pageTable, page, 0);
+}
 
-uniform float cutoffLow, cutoffHigh, cutoffCoeff;
+// Features are enabled by defines injected into the source of each program variant:
+// CHANNELS, LIGHTING, JITTER, PREINTEGRATION, GRADIENT and VIRTUAL_TEXTURE (texture3d is the brick atlas).
 
-uniform float step;
-uniform float stepMultCoeff;
+bool isResident(vec3 coord) {
+#ifdef VIRTUAL_TEXTURE
+    return pageEntry(coord).a != 0u;
+#else
+    return true;
+#endif
+}
 
-uniform vec3 eyePosition;
-uniform vec3 lightPosition;
-uniform bool lightingEnabled;
+float getValue(vec3 coord) {
+#ifdef VIRTUAL_TEXTURE
+    vec3 voxel = clamp(coord, vec3(0.0), vec3(1.0)) * volumeSize;
+    ivec3 page = clamp(ivec3(voxel / pageSize), ivec3(0), textureSize(pageTable, 0) - ivec3(1));
+    uvec4 entry = texelFetch(pageTable, page, 0);
+    if (entry.a == 0u) {
+        return 0.0; // missing bricks are not rendered, see isResident()
+    }
+    // Slot origin in the atlas, then the apron, then the position inside the brick.
+    vec3 atlasVoxel = vec3(entry.rgb) * (pageSize + 2.0) + vec3(1.0) + voxel - vec3(page) * pageSize;
+    return textureLod(texture3d, atlasVoxel / atlasSize, 0.0).r;
+#else
+    return textureLod(texture3d, coord, lod).r;
+#endif
+}
 
-uniform sampler2D jitter;
-uniform int jitterSize;
-uniform bool jitterEnabled;
+vec4 classify(float value) {
+    return texture(transferFunction, value);
+}
 
-float getValue(vec3 coord) {
-    return texture(texture3d, coord).r;
+#ifdef CHANNELS
+// Extra channels classified at the position and mixed with the classified value of the data texture:
+// opacities combine like of matter at the same spot, colors are weighted by opacity.
+vec4 mixChannels(vec4 classified, vec3 coord) {
+    vec4 values = texture(channels, coord);
+    float transparency = 1.0 - classified.a;
+    vec3 weighted = classified.rgb * classified.a;
+    float weights = classified.a;
+    float rows = float(textureSize(channelFunctions, 0).y);
+    for (int c = 0; c < numChannels; c++) {
+        vec4 channel = texture(channelFunctions, vec2(values[c], (float(c) + 0.5) / rows));
+        transparency *= 1.0 - channel.a;
+        weighted += channel.rgb * channel.a;
+        weights += channel.a;
+    }
+    return vec4(weighted / max(weights, 1e-6), 1.0 - transparency);
 }
+#endif
 
-vec3 getColor(float value) {
-    return texture(palette, value).rgb;
+// Opacity of a sample for the slice distance (opacity correction).
+float correctAlpha(float alpha) {
+    return 1.0 - pow(max(1.0 - alpha, 0.0), stepMultCoeff);
 }
 
-float getAlpha(float value) {
-    return texture(opacity, value).r;
+// Average opacity-weighted color (rgb) and opacity (a) over the ray segment between two values.
+vec4 getSegment(float front, float back) {
+    // Map values onto texel centers of the table.
+    vec2 coord = (vec2(front, back) * float(preintegrationSize - 1) + vec2(0.5)) / float(preintegrationSize);
+    return texture(preintegrated, coord);
 }
 
 vec3 shade(vec3 N, vec3 V, vec3 L) {
@@ -64,46 +133,72 @@ vec3 gradient(vec3 coord) {
     sample2.y = getValue(coord + vec3(0.0, delta, 0.0));
     sample1.z = getValue(coord - vec3(0.0, 0.0, delta));
     sample2.z = getValue(coord + vec3(0.0, 0.0, delta));
-    return normalize(sample2 - sample1);
+    vec3 diff = sample2 - sample1;
+    return (dot(diff, diff) > 0.0 ? normalize(diff) : vec3(0.0));
 }
 
-void main()
-{
-    // Check that texCoord in [0,1] range.
-    vec3 s1 = sign(vec3(1.0) - texCoord);
-    vec3 s2 = sign(texCoord);
-    if (dot(s1, s2) < 3) {
-        discard;
+// Zero where the value is uniform, so the sample isn't lit.
+vec3 normal(vec3 coord) {
+#ifdef GRADIENT
+    // One fetch of the precomputed gradient instead of six.
+    vec4 texel = texture(gradientTexture, coord);
+    if (texel.a < 0.5 / 255.0) {
+        return vec3(0.0);
     }
+    vec3 N = texel.rgb * 2.0 - vec3(1.0);
+    return N / max(length(N), 1e-4);
+#else
+    return gradient(coord);
+#endif
+}
 
+void main()
+{
+    // Slice polygons are clipped by the volume box, so there is nothing to discard outside of it.
     vec3 position = texCoord;
+    vec3 direction = normalize(position * 2.0 - vec3(1.0) - eyePosition); // ray direction from eye
 
-    if (jitterEnabled) {
-        float jitterCoeff = texture(jitter, gl_FragCoord.xy / vec2(jitterSize)).r;
-        vec3 coord = position * 2.0 - vec3(1.0); // currect coordinate into [-1,1] cube
-        vec3 direction = normalize(coord - eyePosition); // ray direction from eye
-        position += direction * step * jitterCoeff;
+#ifdef JITTER
+    float jitterCoeff = texture(jitter, gl_FragCoord.xy / vec2(jitterSize)).r;
+    position += direction * step * jitterCoeff;
+#endif
+
+#ifdef VIRTUAL_TEXTURE
+    if (!isResident(position)) {
+        discard; // missing brick of the virtual texture
     }
+#endif
 
     float value = getValue(position);
 
-    if (value < cutoffLow || value > cutoffHigh) {
-        discard;
-    }
+#ifdef PREINTEGRATION
+    // Classify the segment between this slice and the next one towards the eye.
+    vec4 segment = getSegment(getValue(position - direction * step), value);
+    vec4 classified = vec4(segment.rgb / max(segment.a, 1e-6), segment.a); // opacity-weighted color is divided back
+#else
+    vec4 classified = classify(value); // values out of the cutoff window have zero opacity
+#endif
 
-    value = (value - cutoffLow) * cutoffCoeff; // rescale into cutoff range
+#ifdef CHANNELS
+    classified = mixChannels(classified, position);
+#endif
 
-    vec3 color = getColor(value);
-    float alpha = getAlpha(value) * stepMultCoeff;
+    float alpha = correctAlpha(classified.a);
+    if (alpha <= 0.0) {
+        discard;
+    }
+    vec3 color = classified.rgb;
 
-    if (lightingEnabled && alpha > 0.05) {
+#ifdef LIGHTING
+    if (alpha > 0.05) {
         vec3 coord = position * 2.0 - vec3(1.0); // currect coordinate into [-1,1] cube
-        vec3 N = gradient(position); // normal
+        vec3 N = normal(position);
         vec3 L = normalize(lightPosition - coord); // direction to light
         vec3 V = normalize(eyePosition - coord); // direction to eye
 
         color += shade(N, V, L);
     }
+#endif
 
     fragColor = vec4(color, alpha);
 }
@@ -1,14 +1,66 @@
 #version 330
 
-in vec3 vertex; // coordinate in eye space
-
 out vec3 texCoord;
 
 uniform mat4 Proj;
 uniform mat4 TexInv;
+uniform vec3 corners[8]; // of the visible box in eye space; corner i is at the maximum along axis k if bit k of i is set
+uniform float firstDepth; // eye space z of the farthest slice
+uniform float sliceDistance; // between neighbouring slices
+
+// Edges of the box join corners which differ in one bit.
+const ivec2 edges[12] = ivec2[12](
+    ivec2(0, 1), ivec2(2, 3), ivec2(4, 5), ivec2(6, 7), // along x
+    ivec2(0, 2), ivec2(1, 3), ivec2(4, 6), ivec2(5, 7), // along y
+    ivec2(0, 4), ivec2(1, 5), ivec2(2, 6), ivec2(3, 7)  // along z
+);
 
 void main()
 {
+    // Slices are instances, from the farthest one towards the eye.
+    float z = firstDepth + sliceDistance * float(gl_InstanceID);
+
+    // Polygon vertices are the points where box edges cross the plane (3 to 6 of them).
+    vec3 points[6];
+    int count = 0;
+    vec3 center = vec3(0.0);
+    for (int i = 0; i < 12 && count < 6; i++) {
+        vec3 a = corners[edges[i].x];
+        vec3 b = corners[edges[i].y];
+        if ((a.z < z) != (b.z < z)) {
+            points[count] = mix(a, b, (z - a.z) / (b.z - a.z));
+            center += points[count];
+            count++;
+        }
+    }
+    if (count < 3) {
+        // Plane misses the box: all vertices of the fan coincide, so nothing is rasterized.
+        gl_Position = vec4(0.0, 0.0, 0.0, 1.0);
+        texCoord = vec3(0.0);
+        return;
+    }
+    center /= float(count);
+
+    // Polygon is convex, so its vertices are ordered by the angle around the centroid; fan vertices past the last one
+    // repeat it and make empty triangles.
+    float angles[6];
+    for (int i = 0; i < count; i++) {
+        angles[i] = atan(points[i].y - center.y, points[i].x - center.x);
+    }
+    int rank = min(gl_VertexID, count - 1);
+    vec3 vertex = points[0];
+    for (int i = 0; i < count; i++) {
+        int smaller = 0;
+        for (int j = 0; j < count; j++) {
+            if (angles[j] < angles[i] || (angles[j] == angles[i] && j < i)) {
+                smaller++;
+            }
+        }
+        if (smaller == rank) {
+            vertex = points[i];
+        }
+    }
+
     vec4 coord = vec4(vertex, 1.0f);
     gl_Position = Proj * coord;
     texCoord = vec3(TexInv * coord); // convert to texture [0,1]^3 space
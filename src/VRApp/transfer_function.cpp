@@ -0,0 +1,112 @@
+#include "transfer_function.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Same as sampling of 1D texture with linear filtering and clamping to edge (texels are centered at (i + 0.5)/n).
+template <typename T>
+T sampleLinear(const std::vector<T> &values, float x) {
+    const auto n = static_cast<int>(values.size());
+    const auto u = std::min(std::max(x * n - 0.5f, 0.0f), static_cast<float>(n - 1));
+    const auto i0 = static_cast<int>(u);
+    const auto i1 = std::min(i0 + 1, n - 1);
+    const auto t = u - static_cast<float>(i0);
+    return values[static_cast<size_t>(i0)] * (1.0f - t) + values[static_cast<size_t>(i1)] * t;
+}
+
+}
+
+bool TransferFunction::setColors(const std::vector<QVector3D> &new_colors) {
+    if (colors == new_colors) {
+        return false;
+    }
+    colors = new_colors;
+    return true;
+}
+
+bool TransferFunction::setOpacities(const std::vector<GLfloat> &new_opacities) {
+    if (opacities == new_opacities) {
+        return false;
+    }
+    opacities = new_opacities;
+    return true;
+}
+
+bool TransferFunction::setCutoff(float low, float high) {
+    if (cutoff_low == low && cutoff_high == high) {
+        return false;
+    }
+    cutoff_low = low;
+    cutoff_high = high;
+    return true;
+}
+
+QVector4D TransferFunction::classify(float value) const {
+    if (isEmpty() || value < cutoff_low || value > cutoff_high) {
+        return QVector4D(0.0f, 0.0f, 0.0f, 0.0f);
+    }
+    const auto cutoff_coeff = (std::abs(cutoff_low - cutoff_high) > 1e-8f ? 1.0f / (cutoff_high - cutoff_low) : 1.0f);
+    const auto v = (value - cutoff_low) * cutoff_coeff;
+    return QVector4D(sampleLinear(colors, v), sampleLinear(opacities, v));
+}
+
+std::vector<GLfloat> TransferFunction::lookupTable(int size) const {
+    std::vector<GLfloat> table(static_cast<size_t>(size) * 4);
+    #pragma omp parallel for
+    for (int i = 0; i < size; i++) {
+        const auto c = classify((static_cast<float>(i) + 0.5f) / static_cast<float>(size));
+        auto *entry = &table[static_cast<size_t>(i) * 4];
+        entry[0] = c.x();
+        entry[1] = c.y();
+        entry[2] = c.z();
+        entry[3] = c.w();
+    }
+    return table;
+}
+
+std::vector<GLfloat> TransferFunction::preintegrationTable(int size) const {
+    const auto n = static_cast<size_t>(size);
+    const auto ds = 1.0 / (size - 1);
+
+    // Running integrals (trapezoidal rule) of opacity-weighted color and opacity over the value,
+    // so any segment average is a difference of two entries.
+    std::vector<double> int_r(n, 0.0), int_g(n, 0.0), int_b(n, 0.0), int_a(n, 0.0);
+    std::vector<QVector4D> samples(n);
+    #pragma omp parallel for
+    for (int i = 0; i < size; i++) {
+        const auto c = classify(static_cast<float>(i * ds));
+        samples[static_cast<size_t>(i)] = QVector4D(c.x() * c.w(), c.y() * c.w(), c.z() * c.w(), c.w());
+    }
+    for (size_t i = 1; i < n; i++) {
+        const auto avg = (samples[i - 1] + samples[i]) * 0.5f;
+        int_r[i] = int_r[i - 1] + static_cast<double>(avg.x()) * ds;
+        int_g[i] = int_g[i - 1] + static_cast<double>(avg.y()) * ds;
+        int_b[i] = int_b[i - 1] + static_cast<double>(avg.z()) * ds;
+        int_a[i] = int_a[i - 1] + static_cast<double>(avg.w()) * ds;
+    }
+
+    std::vector<GLfloat> table(n * n * 4);
+    #pragma omp parallel for
+    for (int b = 0; b < size; b++) {
+        for (int f = 0; f < size; f++) {
+            auto *entry = &table[(static_cast<size_t>(b) * n + static_cast<size_t>(f)) * 4];
+            if (f == b) {
+                const auto &s = samples[static_cast<size_t>(f)];
+                entry[0] = s.x();
+                entry[1] = s.y();
+                entry[2] = s.z();
+                entry[3] = s.w();
+            } else {
+                const auto fi = static_cast<size_t>(f), bi = static_cast<size_t>(b);
+                const auto len = static_cast<double>(b - f) * ds;
+                entry[0] = static_cast<GLfloat>((int_r[bi] - int_r[fi]) / len);
+                entry[1] = static_cast<GLfloat>((int_g[bi] - int_g[fi]) / len);
+                entry[2] = static_cast<GLfloat>((int_b[bi] - int_b[fi]) / len);
+                entry[3] = static_cast<GLfloat>((int_a[bi] - int_a[fi]) / len);
+            }
+        }
+    }
+    return table;
+}
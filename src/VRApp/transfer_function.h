@@ -0,0 +1,44 @@
+#pragma once
+
+#include <QOpenGLFunctions>
+#include <QVector3D>
+#include <QVector4D>
+
+#include <vector>
+
+/*
+ * CPU-side classification of volume values: color and opacity palettes with a cutoff window.
+ * Mirrors how shaders sample palettes (linear filtering, clamp to edge),
+ * and derives lookup tables from them.
+ */
+class TransferFunction {
+public:
+    TransferFunction() = default;
+
+    // Setters return true if the function has changed.
+    bool setColors(const std::vector<QVector3D> &colors);
+    bool setOpacities(const std::vector<GLfloat> &opacities);
+    bool setCutoff(float low, float high);
+
+    bool isEmpty() const {
+        return colors.empty() || opacities.empty();
+    }
+
+    // Color (rgb) and opacity (a) of a value from [0, 1]: zero outside the cutoff window,
+    // inside the window the value is rescaled to [0, 1] before palette lookup.
+    QVector4D classify(float value) const;
+
+    // Table of size RGBA entries with classified values at texel centers (i + 0.5)/size,
+    // so a linearly filtered 1D texture lookup replaces palette lookups and the cutoff test.
+    std::vector<GLfloat> lookupTable(int size) const;
+
+    // Pre-integrated table of size x size RGBA entries, row-major by back value.
+    // Entry (front, back) is the average over the segment between the two values
+    // of opacity-weighted color (rgb) and opacity (a); value of entry i is i/(size - 1).
+    std::vector<GLfloat> preintegrationTable(int size) const;
+
+private:
+    std::vector<QVector3D> colors;
+    std::vector<GLfloat> opacities;
+    float cutoff_low {0.0f}, cutoff_high {1.0f};
+};
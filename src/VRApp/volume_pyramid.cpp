@@ -0,0 +1,124 @@
+#include "volume_pyramid.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+struct Tap {
+    size_t index;
+    float weight;
+};
+
+using Taps = std::vector<std::vector<Tap>>;
+
+// For each of m output samples, input samples (of n) it covers and their weights.
+Taps makeTaps(size_t n, size_t m) {
+    Taps taps(m);
+    const auto ratio = static_cast<double>(n) / static_cast<double>(m);
+    for (size_t i = 0; i < m; i++) {
+        const auto a = static_cast<double>(i) * ratio, b = static_cast<double>(i + 1) * ratio;
+        const auto last = std::min(static_cast<size_t>(std::ceil(b)), n);
+        for (auto j = static_cast<size_t>(std::floor(a)); j < last; j++) {
+            const auto coverage = std::min(b, static_cast<double>(j + 1)) - std::max(a, static_cast<double>(j));
+            if (coverage > 1e-6) {
+                taps[i].push_back(Tap {j, static_cast<float>(coverage / ratio)});
+            }
+        }
+    }
+    return taps;
+}
+
+float reduce(const std::vector<Tap> &taps, const GLfloat *src, size_t stride, PyramidFilter filter) {
+    if (filter == PF_MAX) {
+        auto result = src[taps.front().index * stride];
+        for (const auto &tap: taps) {
+            result = std::max(result, src[tap.index * stride]);
+        }
+        return result;
+    }
+    float result = 0.0f;
+    for (const auto &tap: taps) {
+        result += src[tap.index * stride] * tap.weight;
+    }
+    return result;
+}
+
+size_t halfSize(size_t size) {
+    return std::max(size / 2, size_t(1));
+}
+
+}
+
+void downsample(const Frame3D<GLfloat> &src, Frame3D<GLfloat> &dst, size_t z_begin, size_t z_end, PyramidFilter filter) {
+    const auto sw = src.width(), sh = src.height(), sd = src.depth();
+    const auto dw = dst.width(), dh = dst.height(), dd = dst.depth();
+    z_end = std::min(z_end, dd);
+    if (z_begin >= z_end) {
+        return;
+    }
+    const auto nz = z_end - z_begin;
+    const auto taps_x = makeTaps(sw, dw), taps_y = makeTaps(sh, dh), taps_z = makeTaps(sd, dd);
+
+    // Separable passes, the one which reduces the depth first, so only needed source slices are read.
+    Frame3D<GLfloat> tmp_z(sw, sh, nz);
+    #pragma omp parallel for collapse(2)
+    for (long long k = 0; k < static_cast<long long>(nz); k++) {
+        for (long long j = 0; j < static_cast<long long>(sh); j++) {
+            const auto &taps = taps_z[z_begin + static_cast<size_t>(k)];
+            const auto *in = src.data() + static_cast<size_t>(j)*sw;
+            auto *out = tmp_z.data() + (static_cast<size_t>(k)*sh + static_cast<size_t>(j))*sw;
+            for (size_t i = 0; i < sw; i++) {
+                out[i] = reduce(taps, in + i, sw*sh, filter);
+            }
+        }
+    }
+    Frame3D<GLfloat> tmp_y(sw, dh, nz);
+    #pragma omp parallel for collapse(2)
+    for (long long k = 0; k < static_cast<long long>(nz); k++) {
+        for (long long j = 0; j < static_cast<long long>(dh); j++) {
+            const auto &taps = taps_y[static_cast<size_t>(j)];
+            const auto *in = tmp_z.data() + static_cast<size_t>(k)*sw*sh;
+            auto *out = tmp_y.data() + (static_cast<size_t>(k)*dh + static_cast<size_t>(j))*sw;
+            for (size_t i = 0; i < sw; i++) {
+                out[i] = reduce(taps, in + i, sw, filter);
+            }
+        }
+    }
+    #pragma omp parallel for collapse(2)
+    for (long long k = 0; k < static_cast<long long>(nz); k++) {
+        for (long long j = 0; j < static_cast<long long>(dh); j++) {
+            const auto *in = tmp_y.data() + (static_cast<size_t>(k)*dh + static_cast<size_t>(j))*sw;
+            auto *out = dst.data() + ((z_begin + static_cast<size_t>(k))*dh + static_cast<size_t>(j))*dw;
+            for (size_t i = 0; i < dw; i++) {
+                out[i] = reduce(taps_x[i], in, 1, filter);
+            }
+        }
+    }
+}
+
+FramePyramid buildPyramid(const Frame3D<GLfloat> &frame, PyramidFilter filter) {
+    FramePyramid levels;
+    const auto *prev = &frame;
+    while (prev->width() > 1 || prev->height() > 1 || prev->depth() > 1) {
+        Frame3D<GLfloat> level(halfSize(prev->width()), halfSize(prev->height()), halfSize(prev->depth()));
+        downsample(*prev, level, 0, level.depth(), filter);
+        levels.push_back(std::move(level));
+        prev = &levels.back();
+    }
+    return levels;
+}
+
+void updatePyramid(const Frame3D<GLfloat> &frame, FramePyramid &levels, size_t z_begin, size_t z_end, PyramidFilter filter) {
+    const auto *prev = &frame;
+    for (auto &level: levels) {
+        // Output slices which cover any of the changed input slices.
+        const auto ratio = static_cast<double>(prev->depth()) / static_cast<double>(level.depth());
+        const auto begin = static_cast<size_t>(std::floor(static_cast<double>(z_begin) / ratio));
+        const auto end = std::min(static_cast<size_t>(std::ceil(static_cast<double>(z_end) / ratio)), level.depth());
+        downsample(*prev, level, begin, end, filter);
+        z_begin = begin;
+        z_end = end;
+        prev = &level;
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "frame3d.h"
+
+#include <QOpenGLFunctions>
+
+#include <vector>
+
+/*
+ * Mipmap pyramid of 3D frames, built on the CPU with separable filters.
+ * Size of each level is max(1, size/2) of the previous one (as GL requires), down to 1x1x1.
+ * For odd sizes an output voxel covers a non-integer number of input voxels,
+ * which contribute with weights proportional to their coverage.
+ */
+
+enum PyramidFilter {
+    PF_BOX = 0, // average, for smooth data
+    PF_MAX      // maximum, keeps thin bright features from vanishing on coarse levels
+};
+
+using FramePyramid = std::vector<Frame3D<GLfloat>>;
+
+// Levels 1, 2, ... of the pyramid: level 0 is the frame itself.
+FramePyramid buildPyramid(const Frame3D<GLfloat> &frame, PyramidFilter filter = PF_BOX);
+
+// Recompute parts of the levels affected by a change of frame slices [z_begin, z_end).
+void updatePyramid(const Frame3D<GLfloat> &frame, FramePyramid &levels, size_t z_begin, size_t z_end,
+                   PyramidFilter filter = PF_BOX);
+
+// Reduce the source into slices [z_begin, z_end) of the destination, which is half the size of the source.
+void downsample(const Frame3D<GLfloat> &src, Frame3D<GLfloat> &dst, size_t z_begin, size_t z_end,
+                PyramidFilter filter = PF_BOX);
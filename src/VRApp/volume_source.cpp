@@ -0,0 +1,107 @@
+#include "volume_source.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+Frame3D<GLfloat> VolumeSource::materialize() const {
+    Frame3D<GLfloat> frame(width(), height(), depth());
+    read(0, 0, 0, frame);
+    return frame;
+}
+
+ProceduralVolumeSource::ProceduralVolumeSource(size_t width, size_t height, size_t depth, Func func,
+                                               size_t brick_size, size_t cache_capacity) :
+    _width(width), _height(height), _depth(depth),
+    func(func),
+    brick_size(brick_size),
+    cache_capacity(cache_capacity)
+{
+    if (brick_size == 0) {
+        throw std::runtime_error("Brick size should be positive");
+    }
+}
+
+void ProceduralVolumeSource::read(size_t x, size_t y, size_t z, Frame3D<GLfloat> &region) const {
+    if (x + region.width() > _width || y + region.height() > _height || z + region.depth() > _depth) {
+        throw std::runtime_error("Region is out of volume");
+    }
+    // Regions larger than the cache would only thrash it, so they are evaluated directly.
+    const auto region_bricks = ((region.width() + brick_size - 1) / brick_size + 1) *
+                               ((region.height() + brick_size - 1) / brick_size + 1) *
+                               ((region.depth() + brick_size - 1) / brick_size + 1);
+    if (region_bricks > cache_capacity) {
+        region.fill([&](size_t i, size_t j, size_t k) -> auto {
+            return func(x + i, y + j, z + k);
+        });
+        return;
+    }
+    for (auto bz = z / brick_size; bz * brick_size < z + region.depth(); bz++) {
+        for (auto by = y / brick_size; by * brick_size < y + region.height(); by++) {
+            for (auto bx = x / brick_size; bx * brick_size < x + region.width(); bx++) {
+                const auto b = brick(bx, by, bz);
+                const auto ox = bx * brick_size, oy = by * brick_size, oz = bz * brick_size;
+                // Copy intersection of the brick and the region.
+                const auto x0 = std::max(x, ox), x1 = std::min(x + region.width(), ox + b->width());
+                const auto y0 = std::max(y, oy), y1 = std::min(y + region.height(), oy + b->height());
+                const auto z0 = std::max(z, oz), z1 = std::min(z + region.depth(), oz + b->depth());
+                for (auto k = z0; k < z1; k++) {
+                    for (auto j = y0; j < y1; j++) {
+                        const auto *src = &b->at(x0 - ox, j - oy, k - oz);
+                        std::copy(src, src + (x1 - x0), &region.at(x0 - x, j - y, k - z));
+                    }
+                }
+            }
+        }
+    }
+}
+
+std::shared_ptr<const ProceduralVolumeSource::Brick> ProceduralVolumeSource::brick(size_t bx, size_t by, size_t bz) const {
+    const auto nx = (_width + brick_size - 1) / brick_size;
+    const auto ny = (_height + brick_size - 1) / brick_size;
+    const auto key = (bz * ny + by) * nx + bx;
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        auto it = cache_map.find(key);
+        if (it != cache_map.end()) {
+            cache_list.splice(cache_list.begin(), cache_list, it->second);
+            return it->second->second;
+        }
+    }
+    // Evaluate outside of the lock: concurrent misses on one brick just compute it twice.
+    auto result = evaluateBrick(bx, by, bz);
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    if (cache_map.find(key) == cache_map.end()) {
+        cache_list.emplace_front(key, result);
+        cache_map[key] = cache_list.begin();
+        while (cache_list.size() > cache_capacity) {
+            cache_map.erase(cache_list.back().first);
+            cache_list.pop_back();
+        }
+    }
+    return result;
+}
+
+std::shared_ptr<const ProceduralVolumeSource::Brick> ProceduralVolumeSource::evaluateBrick(size_t bx, size_t by, size_t bz) const {
+    const auto ox = bx * brick_size, oy = by * brick_size, oz = bz * brick_size;
+    if (ox >= _width || oy >= _height || oz >= _depth) {
+        throw std::runtime_error("Brick is out of volume");
+    }
+    auto result = std::make_shared<Brick>(std::min(brick_size, _width - ox),
+                                          std::min(brick_size, _height - oy),
+                                          std::min(brick_size, _depth - oz));
+    result->fill([&](size_t i, size_t j, size_t k) -> auto {
+        return func(ox + i, oy + j, oz + k);
+    });
+    return result;
+}
+
+GLfloat ProceduralVolumeSource::value(size_t x, size_t y, size_t z) const {
+    const auto b = brick(x / brick_size, y / brick_size, z / brick_size);
+    return b->at(x % brick_size, y % brick_size, z % brick_size);
+}
+
+Frame3D<GLfloat> ProceduralVolumeSource::materialize() const {
+    Frame3D<GLfloat> frame(_width, _height, _depth);
+    frame.fill(func);
+    return frame;
+}
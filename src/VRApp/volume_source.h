@@ -0,0 +1,84 @@
+#pragma once
+
+#include "frame3d.h"
+
+#include <QOpenGLFunctions>
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+/*
+ * Volume which values can be read by regions without having the whole volume in memory.
+ */
+class VolumeSource {
+public:
+    virtual ~VolumeSource() = default;
+
+    virtual size_t width() const = 0;
+    virtual size_t height() const = 0;
+    virtual size_t depth() const = 0;
+
+    // Read values of the region which starts at (x, y, z) and has size of the 'region' frame.
+    virtual void read(size_t x, size_t y, size_t z, Frame3D<GLfloat> &region) const = 0;
+
+    // Read the whole volume into memory.
+    virtual Frame3D<GLfloat> materialize() const;
+};
+
+/*
+ * Volume which values are computed by a function of voxel coords.
+ * Values are evaluated lazily by bricks; recently used bricks are kept in a small LRU cache.
+ */
+class ProceduralVolumeSource : public VolumeSource {
+public:
+    using Func = std::function<double(size_t, size_t, size_t)>;
+    using Brick = Frame3D<GLfloat>;
+
+    ProceduralVolumeSource(size_t width, size_t height, size_t depth, Func func,
+                           size_t brick_size = 32, size_t cache_capacity = 64);
+
+    size_t width() const override {
+        return _width;
+    }
+
+    size_t height() const override {
+        return _height;
+    }
+
+    size_t depth() const override {
+        return _depth;
+    }
+
+    size_t brickSize() const {
+        return brick_size;
+    }
+
+    void read(size_t x, size_t y, size_t z, Frame3D<GLfloat> &region) const override;
+
+    // Brick with index (bx, by, bz); border bricks may be smaller than brick size.
+    std::shared_ptr<const Brick> brick(size_t bx, size_t by, size_t bz) const;
+
+    GLfloat value(size_t x, size_t y, size_t z) const;
+
+    // Evaluate the function directly for all voxels (bypassing the cache).
+    Frame3D<GLfloat> materialize() const override;
+
+private:
+    std::shared_ptr<const Brick> evaluateBrick(size_t bx, size_t by, size_t bz) const;
+
+private:
+    size_t _width, _height, _depth;
+    Func func;
+    size_t brick_size;
+    size_t cache_capacity;
+
+    // LRU cache of bricks: most recently used bricks are at the front of the list.
+    using CacheList = std::list<std::pair<size_t, std::shared_ptr<const Brick>>>;
+    mutable CacheList cache_list;
+    mutable std::unordered_map<size_t, CacheList::iterator> cache_map;
+    mutable std::mutex cache_mutex;
+};
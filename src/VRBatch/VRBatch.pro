@@ -0,0 +1,30 @@
+#-------------------------------------------------
+#
+# Headless renderer of volume images (see main.cpp)
+#
+#-------------------------------------------------
+
+QT += core gui
+CONFIG += console c++14
+CONFIG -= app_bundle
+
+TARGET = VRBatch
+TEMPLATE = app
+
+DESTDIR = $$PWD
+
+QMAKE_CXXFLAGS += -fopenmp
+QMAKE_LFLAGS += -fopenmp
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+# Rendering code is shared with VRApp.
+include(../VRApp/render_core.pri)
+
+SOURCES += main.cpp \
+    batch_job.cpp \
+    offscreen_renderer.cpp
+
+HEADERS += \
+    batch_job.h \
+    offscreen_renderer.h
@@ -0,0 +1,181 @@
+#include "batch_job.h"
+#include "palette_util.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QStringList>
+#include <QTextStream>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+std::runtime_error jobError(int line, const QString &message) {
+    return std::runtime_error("Line " + std::to_string(line) + ": " + message.toStdString());
+}
+
+float toFloat(const QString &value, int line) {
+    bool ok = false;
+    const auto result = value.toFloat(&ok);
+    if (!ok) {
+        throw jobError(line, "not a number: " + value);
+    }
+    return result;
+}
+
+int toInt(const QString &value, int line) {
+    bool ok = false;
+    const auto result = value.toInt(&ok);
+    if (!ok) {
+        throw jobError(line, "not an integer: " + value);
+    }
+    return result;
+}
+
+bool toBool(const QString &value, int line) {
+    if (value == "1" || value == "true") {
+        return true;
+    }
+    if (value == "0" || value == "false") {
+        return false;
+    }
+    throw jobError(line, "not a boolean: " + value);
+}
+
+QColor toColor(const QString &value, int line) {
+    const QColor color(value);
+    if (!color.isValid()) {
+        throw jobError(line, "not a color: " + value);
+    }
+    return color;
+}
+
+std::vector<QVector3D> toColorPalette(const QString &value, int line) {
+    if (value == "rainbow") {
+        return makeRainbowPalette();
+    }
+    if (value == "rainbow-black") {
+        return makeRainbowWithBlackPalette();
+    }
+    if (value == "monochrome") {
+        return makeMonochromePalette();
+    }
+    const auto color = toColor(value, line);
+    return {QVector3D(static_cast<float>(color.redF()), static_cast<float>(color.greenF()), static_cast<float>(color.blueF()))};
+}
+
+std::vector<GLfloat> toOpacityPalette(const QString &value, int line) {
+    if (value == "default") {
+        return makeDefaultOpacityPalette();
+    }
+    if (value == "log") {
+        return makeLogOpacityPalette();
+    }
+    if (value == "const") {
+        return {1.0f};
+    }
+    if (value.startsWith("pow")) {
+        const auto n = toInt(value.mid(3), line);
+        if (n >= 1 && n <= 9) {
+            return makePowOpacityPalette(n);
+        }
+    }
+    throw jobError(line, "unknown opacity palette: " + value);
+}
+
+void setOption(BatchJob &job, const QString &key, const QString &value, const QDir &dir) {
+    const auto line = job.line;
+    if (key == "volume") {
+        job.volume = QFileInfo(dir, value).absoluteFilePath();
+    } else if (key == "output") {
+        job.output = QFileInfo(dir, value).absoluteFilePath();
+    } else if (key == "size") {
+        const auto parts = value.split('x');
+        if (parts.size() != 2) {
+            throw jobError(line, "size should be WxH: " + value);
+        }
+        job.width = toInt(parts[0], line);
+        job.height = toInt(parts[1], line);
+        if (job.width <= 0 || job.height <= 0) {
+            throw jobError(line, "size should be positive: " + value);
+        }
+    } else if (key == "yaw") {
+        job.yaw = toFloat(value, line);
+    } else if (key == "pitch") {
+        job.pitch = toFloat(value, line);
+    } else if (key == "distance") {
+        job.distance = toFloat(value, line);
+    } else if (key == "cutoff") {
+        const auto parts = value.split(':');
+        if (parts.size() != 2) {
+            throw jobError(line, "cutoff should be low:high: " + value);
+        }
+        job.cutoff_low = toFloat(parts[0], line);
+        job.cutoff_high = toFloat(parts[1], line);
+    } else if (key == "step") {
+        job.step_multiplier = std::max(toInt(value, line), 1);
+    } else if (key == "background") {
+        job.background = toColor(value, line);
+    } else if (key == "colors") {
+        job.colors = toColorPalette(value, line);
+    } else if (key == "opacity") {
+        job.opacities = toOpacityPalette(value, line);
+    } else if (key == "lighting") {
+        job.lighting = toBool(value, line);
+    } else if (key == "jitter") {
+        job.jitter = toBool(value, line);
+    } else if (key == "preintegration") {
+        job.preintegration = toBool(value, line);
+    } else if (key == "scale") {
+        job.correct_scale = toBool(value, line);
+    } else {
+        throw jobError(line, "unknown key: " + key);
+    }
+}
+
+}
+
+std::vector<BatchJob> loadJobs(const QString &file_name) {
+    QFile file(file_name);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        throw std::runtime_error("Cannot open " + file_name.toStdString());
+    }
+    const auto dir = QFileInfo(file_name).absoluteDir();
+    const QRegularExpression spaces("\\s+");
+    const QRegularExpression comment("(^|\\s)#.*$");
+
+    std::vector<BatchJob> jobs;
+    QTextStream in(&file);
+    int line = 0;
+    while (!in.atEnd()) {
+        // Colors are written as #rrggbb, so only '#' at the start of a token begins a comment.
+        const auto text = in.readLine().remove(comment);
+        line++;
+        const auto tokens = text.split(spaces, QString::SkipEmptyParts);
+        if (tokens.isEmpty()) {
+            continue;
+        }
+
+        // Defaults of VRApp.
+        BatchJob job;
+        job.line = line;
+        job.colors = makeRainbowWithBlackPalette();
+        job.opacities = makePowOpacityPalette(1);
+        for (const auto &token: tokens) {
+            const auto separator = token.indexOf('=');
+            if (separator <= 0) {
+                throw jobError(line, "expected key=value: " + token);
+            }
+            setOption(job, token.left(separator), token.mid(separator + 1), dir);
+        }
+        if (job.volume.isEmpty() || job.output.isEmpty()) {
+            throw jobError(line, "volume and output are required");
+        }
+        jobs.push_back(job);
+    }
+    return jobs;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QColor>
+#include <QOpenGLFunctions>
+#include <QString>
+#include <QVector3D>
+
+#include <vector>
+
+// Image of a dataset to render with its camera, transfer function and settings.
+struct BatchJob {
+    int line {0}; // in the job file, for messages
+    QString volume; // .frame or .cube file
+    QString output; // image file, its format is chosen by the extension
+    int width {512}, height {512};
+    // Rotation of the volume in degrees, as if it's dragged in VRApp.
+    float yaw {0.0f}, pitch {0.0f};
+    // From the eye to the center of the volume; the eye looks along the diagonal, like in VRApp.
+    float distance {5.196f};
+    std::vector<QVector3D> colors;
+    std::vector<GLfloat> opacities;
+    float cutoff_low {0.0f}, cutoff_high {1.0f};
+    QColor background {0, 0, 25};
+    int step_multiplier {1};
+    bool lighting {false};
+    bool jitter {false};
+    bool preintegration {false};
+    bool correct_scale {false};
+};
+
+/*
+ * Jobs are read from a text file, a job per line: whitespace-separated key=value pairs;
+ * a token starting with '#' starts a comment.
+ * volume and output are required, the others are optional:
+ *   size=WxH, yaw=deg, pitch=deg, distance=d, cutoff=low:high, step=n, background=#rrggbb,
+ *   colors=rainbow|rainbow-black|monochrome|#rrggbb, opacity=default|pow1..pow9|log|const,
+ *   lighting=0|1, jitter=0|1, preintegration=0|1, scale=0|1 (correct scale of a non-cubic volume).
+ * Relative paths are relative to the job file. Throws on errors, with the line number.
+ */
+std::vector<BatchJob> loadJobs(const QString &file_name);
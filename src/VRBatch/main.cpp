@@ -0,0 +1,84 @@
+/*
+ * Headless renderer of volume images, e.g. thumbnails of many datasets on servers without a GPU.
+ * Jobs (dataset, camera, transfer function, output image) are read from a file, see batch_job.h.
+ * Shaders are read from the VRApp directory, next to the one of this executable by default.
+ */
+
+#include "batch_job.h"
+#include "offscreen_renderer.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QStringList>
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+int main(int argc, char *argv[]) {
+    // Nothing is shown, so no windowing system is needed (unless another platform is asked for).
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QGuiApplication app(argc, argv);
+
+    auto args = app.arguments();
+    auto shader_dir = QCoreApplication::applicationDirPath() + "/../VRApp";
+    const auto shaders_arg = args.indexOf("--shaders");
+    if (shaders_arg > 0 && shaders_arg + 1 < args.size()) {
+        shader_dir = args[shaders_arg + 1];
+        args.erase(args.begin() + shaders_arg, args.begin() + shaders_arg + 2);
+    }
+    if (args.size() != 2) {
+        std::cerr << "Usage: " << argv[0] << " [--shaders <VRApp dir>] <job_file>" << std::endl;
+        return -1;
+    }
+
+    try {
+        // Paths of jobs are made absolute, so the current directory can be changed to find shaders.
+        const auto jobs = loadJobs(args[1]);
+        if (!QFileInfo(QDir(shader_dir), "shaders/raycast.frag").exists()) {
+            throw std::runtime_error("No shaders in " + shader_dir.toStdString() + ", set the VRApp directory with --shaders");
+        }
+        QDir::setCurrent(shader_dir);
+
+        // Jobs of a dataset are rendered one after another, so it's loaded once.
+        std::vector<size_t> order(jobs.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&jobs](size_t a, size_t b) {
+            return jobs[a].volume < jobs[b].volume;
+        });
+
+        OffscreenRenderer renderer;
+        QElapsedTimer timer;
+        timer.start();
+        size_t rendered = 0;
+        for (const auto index: order) {
+            const auto &job = jobs[index];
+            try {
+                const auto image = renderer.render(job);
+                QDir().mkpath(QFileInfo(job.output).absolutePath());
+                if (!image.save(job.output)) {
+                    throw std::runtime_error("Failed to save " + job.output.toStdString());
+                }
+                rendered++;
+            }
+            catch (const std::exception &e) {
+                // Other jobs are still rendered.
+                std::cerr << "Line " << job.line << ": " << e.what() << std::endl;
+            }
+        }
+        const auto seconds = static_cast<double>(timer.nsecsElapsed()) * 1e-9;
+        std::cout << "Rendered " << rendered << " of " << jobs.size() << " images in " << seconds << " s ("
+                  << (seconds > 0.0 ? static_cast<double>(rendered) / seconds : 0.0) << " images/s)" << std::endl;
+        return (rendered == jobs.size() ? 0 : 1);
+    }
+    catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+}
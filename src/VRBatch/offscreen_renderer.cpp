@@ -0,0 +1,144 @@
+#include "offscreen_renderer.h"
+#include "brick_volume.h"
+#include "frame_loader.h"
+#include "gradient_volume.h"
+#include "volume_pyramid.h"
+#include "cube/cube_util.h"
+
+#include <QMatrix4x4>
+#include <QOpenGLFunctions>
+#include <QSurfaceFormat>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+// Images are rendered one at a time, so textures are uploaded whole instead of over several frames.
+void uploadAll(VolumeTexture &volume) {
+    while (volume.isUploading()) {
+        volume.process(256*1024*1024);
+    }
+}
+
+}
+
+OffscreenRenderer::OffscreenRenderer() :
+    data_volume(QOpenGLTexture::R32F, QOpenGLTexture::Red, QOpenGLTexture::Float32, sizeof(GLfloat)),
+    gradient_volume(QOpenGLTexture::RGBA8_UNorm, QOpenGLTexture::RGBA, QOpenGLTexture::UInt32_RGBA8_Rev, sizeof(GLuint))
+{
+    QSurfaceFormat format;
+    format.setVersion(3, 3);
+    format.setProfile(QSurfaceFormat::CoreProfile);
+    context.setFormat(format);
+    if (!context.create()) {
+        throw std::runtime_error("Failed to create OpenGL context");
+    }
+    surface.setFormat(context.format());
+    surface.create();
+    if (!surface.isValid() || !context.makeCurrent(&surface)) {
+        throw std::runtime_error("Failed to make OpenGL context current on an offscreen surface");
+    }
+    if (context.format().version() < qMakePair(3, 3)) {
+        throw std::runtime_error("OpenGL 3.3 is required");
+    }
+    context.functions()->glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &max_texture_size);
+
+    renderer = std::make_shared<RayCastRenderer>();
+    renderer->init(context.functions());
+}
+
+OffscreenRenderer::~OffscreenRenderer() {
+    // Free GL resources while the context is still alive.
+    context.makeCurrent(&surface);
+    data_volume.release();
+    gradient_volume.release();
+    renderer.reset();
+    fbo.reset();
+    context.doneCurrent();
+}
+
+void OffscreenRenderer::setVolume(const QString &file_name, bool lighting) {
+    if (file_name != volume_file) {
+        volume_file.clear(); // until the new one is loaded
+        gradient_ready = false;
+
+        // Frame is decimated to fit a texture, but keeps the scale of the original data.
+        LoadPolicy policy;
+        policy.max_texture_size = static_cast<size_t>(max_texture_size);
+        LoadInfo info;
+        const auto path = file_name.toStdString();
+        frame = std::make_shared<const Frame3D<GLfloat>>(file_name.endsWith(".cube") ? cube::loadCube(path)
+                                                                                     : FrameLoader::load(path, policy, &info));
+        extent = (info.factor > 1 ? QVector3D(info.width, info.height, info.depth)
+                                  : QVector3D(frame->width(), frame->height(), frame->depth()));
+
+        data_volume.setFrame(frame, std::make_shared<const FramePyramid>(buildPyramid(*frame)));
+        uploadAll(data_volume);
+        renderer->setDataTexture(data_volume.texture());
+        renderer->setBrickVolume(std::make_shared<const BrickVolume>(*frame));
+        volume_file = file_name;
+    }
+    // Gradients are computed for the first job with lighting and kept for the next ones.
+    if (lighting && !gradient_ready) {
+        gradient_volume.setFrame(std::make_shared<const GradientFrame>(computeGradient(*frame)));
+        uploadAll(gradient_volume);
+        gradient_ready = true;
+    }
+    renderer->setGradientTexture(lighting ? gradient_volume.texture() : nullptr);
+}
+
+QImage OffscreenRenderer::render(const BatchJob &job) {
+    if (!context.makeCurrent(&surface)) {
+        throw std::runtime_error("Failed to make OpenGL context current");
+    }
+    setVolume(job.volume, job.lighting);
+
+    if (!fbo || fbo->size() != QSize(job.width, job.height)) {
+        fbo = std::make_unique<QOpenGLFramebufferObject>(job.width, job.height, QOpenGLFramebufferObject::CombinedDepthStencil);
+    }
+    fbo->bind();
+
+    auto *gl = context.functions();
+    gl->glViewport(0, 0, job.width, job.height);
+    gl->glClearColor(static_cast<GLfloat>(job.background.redF()),
+                     static_cast<GLfloat>(job.background.greenF()),
+                     static_cast<GLfloat>(job.background.blueF()), 1.0f);
+    gl->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // The same camera as in VRApp: the eye looks at the volume along the diagonal.
+    QMatrix4x4 model;
+    model.rotate(job.yaw, QVector3D(0.0f, 1.0f, 0.0f));
+    model.rotate(job.pitch, QVector3D(1.0f, 0.0f, 0.0f));
+    if (job.correct_scale) {
+        const auto md = std::max(extent.x(), std::max(extent.y(), extent.z()));
+        model.scale(extent / md);
+    }
+
+    QMatrix4x4 view;
+    view.lookAt(QVector3D(1.0f, 1.0f, 1.0f).normalized() * job.distance, QVector3D(0.0f, 0.0f, 0.0f), QVector3D(0.0f, 1.0f, 0.0f));
+
+    QMatrix4x4 projection;
+    projection.perspective(45.0f, float(job.width) / float(job.height), 0.01f, 100.0f);
+
+    // Lookup tables are rebuilt only if the palettes or cutoff differ from the previous job.
+    renderer->setMVP(model, view, projection);
+    renderer->setColorPalette(job.colors);
+    renderer->setOpacityPalette(job.opacities);
+    renderer->setCutoff(job.cutoff_low, job.cutoff_high);
+    renderer->enableLighting(job.lighting);
+    renderer->enableJitter(job.jitter);
+    renderer->enablePreintegration(job.preintegration);
+    renderer->setStepMultiplier(job.step_multiplier);
+
+    // The renderers blend alpha like color, which suits a window but leaves a*a+(1-a) in the framebuffer;
+    // the image keeps the opaque alpha of the background instead, so the saved file isn't see-through.
+    gl->glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ZERO, GL_ONE);
+    renderer->render(gl);
+    gl->glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    // Without virtual texturing the whole volume is resident, so a single render is complete.
+    const auto image = fbo->toImage();
+    fbo->release();
+    return image;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "batch_job.h"
+#include "frame3d.h"
+#include "render/ray_cast_renderer.h"
+#include "render/volume_texture.h"
+
+#include <QImage>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QVector3D>
+
+#include <memory>
+
+/*
+ * Renders volumes into images without a window: the ray caster of VRApp draws into a framebuffer object
+ * of an offscreen surface, so it works without a display and with software GL (e.g. Mesa llvmpipe).
+ * The context, shader programs and textures live as long as the renderer: a job on the same dataset
+ * as the previous one only changes the camera and lookup tables, so jobs should be grouped by dataset.
+ * Throws if there is no OpenGL 3.3 context.
+ */
+class OffscreenRenderer {
+public:
+    OffscreenRenderer();
+    ~OffscreenRenderer();
+
+    OffscreenRenderer(const OffscreenRenderer &) = delete;
+    OffscreenRenderer &operator=(const OffscreenRenderer &) = delete;
+
+    QImage render(const BatchJob &job);
+
+private:
+    // Load the dataset unless it's the current one, and compute its gradients if they're needed.
+    void setVolume(const QString &file_name, bool lighting);
+
+private:
+    QOpenGLContext context;
+    QOffscreenSurface surface;
+    std::unique_ptr<QOpenGLFramebufferObject> fbo;
+
+    std::shared_ptr<RayCastRenderer> renderer;
+    VolumeTexture data_volume, gradient_volume;
+
+    QString volume_file; // of the current dataset
+    std::shared_ptr<const Frame3D<GLfloat>> frame;
+    QVector3D extent; // of the original data if the frame is decimated
+    bool gradient_ready = false;
+    int max_texture_size {0};
+};